@@ -14,11 +14,17 @@
 #define MAX_LINE_LENGTH     64
 #define MAX_HISTORY_LENGTH  10
 #define PROMPT              "$ "
-
-char write_buffer[1024];
-
-char terminal_line_buffer[MAX_LINE_LENGTH + 1];
-char terminal_history_buffer[MAX_HISTORY_LENGTH * (MAX_LINE_LENGTH + 1)];
+#define ASYNC_QUEUE_LENGTH  4
+#define WRITE_BUFFER_SIZE   1024
+#define HIBERNATION_BLOB_SIZE 256
+#define IDLE_TIMEOUT_MS     60000
+#define POLL_TIMEOUT_MS     100
+
+char terminal_buffer_slabs[TERMINAL_BUFFER_POOL_SLAB_SIZE(MAX_LINE_LENGTH, WRITE_BUFFER_SIZE, MAX_HISTORY_LENGTH)];
+char terminal_hibernation_blob[HIBERNATION_BLOB_SIZE];
+Terminal_Buffer_Pool_t terminal_buffer_pool;
+/* Async entries stay resident while the terminal is hibernated, so the queue is kept short */
+Terminal_Async_Entry_t terminal_async_queue[ASYNC_QUEUE_LENGTH];
 
 int client_socket = -1;
 
@@ -98,19 +104,32 @@ int main()
     WSADATA wsaData;
     Terminal_t console;
 
-    terminal_init(&console,
-                  terminal_line_buffer,
-                  MAX_LINE_LENGTH,
-                  write_buffer,
-                  sizeof(write_buffer),
-                  terminal_history_buffer,
-                  MAX_HISTORY_LENGTH,
-                  on_terminal_write_request,
-                  on_terminal_line_read,
-                  on_terminal_suggestion_request);
-
+    if (!terminal_buffer_pool_init(&terminal_buffer_pool,
+                                   terminal_buffer_slabs,
+                                   1,
+                                   MAX_LINE_LENGTH,
+                                   WRITE_BUFFER_SIZE,
+                                   MAX_HISTORY_LENGTH))
+    {
+        printf("Failed to initialize terminal buffer pool\n");
+    }
+    else if (!terminal_init_pooled(&console,
+                                   &terminal_buffer_pool,
+                                   terminal_hibernation_blob,
+                                   sizeof(terminal_hibernation_blob),
+                                   IDLE_TIMEOUT_MS,
+                                   on_terminal_write_request,
+                                   on_terminal_line_read,
+                                   on_terminal_suggestion_request))
+    {
+        printf("Failed to initialize terminal\n");
+    }
+    else if (!terminal_set_async_queue(&console, terminal_async_queue, ASYNC_QUEUE_LENGTH))
+    {
+        printf("Failed to set terminal async queue\n");
+    }
     /* Initialize winsock */
-    if (0 != WSAStartup(MAKEWORD(2, 2), &wsaData))
+    else if (0 != WSAStartup(MAKEWORD(2, 2), &wsaData))
     {
         perror("Failed to initialize winsock");
     }
@@ -163,10 +182,33 @@ int main()
 
                             terminal_set_prompt(&console, PROMPT);
 
+                            DWORD last_tick_ms = GetTickCount();
+
                             while (1)
                             {
                                 char byte;
-                                int recv_status = recv(client_socket, &byte, 1, 0);
+                                int recv_status;
+                                fd_set read_fds;
+                                struct timeval timeout = { 0, POLL_TIMEOUT_MS * 1000 };
+                                int select_status;
+                                DWORD elapsed_ms;
+
+                                /* Wait for input with timeout, so messages posted by other threads get printed */
+                                FD_ZERO(&read_fds);
+                                FD_SET(client_socket, &read_fds);
+
+                                select_status = select(client_socket + 1, &read_fds, NULL, NULL, &timeout);
+                                elapsed_ms = GetTickCount() - last_tick_ms;
+                                last_tick_ms += elapsed_ms;
+
+                                if (0 == select_status)
+                                {
+                                    terminal_process_async(&console, elapsed_ms);
+                                    terminal_tick(&console, elapsed_ms);
+                                    continue;
+                                }
+
+                                recv_status = recv(client_socket, &byte, 1, 0);
 
                                 if (0 == recv_status)
                                 {
@@ -180,7 +222,12 @@ int main()
                                 }
                                 else
                                 {
-                                    terminal_feed(&console, byte);
+                                    /* Hibernated terminal can't be restored while the buffer pool is exhausted */
+                                    while (!terminal_feed(&console, byte))
+                                    {
+                                        Sleep(POLL_TIMEOUT_MS);
+                                    }
+                                    terminal_process_async(&console, elapsed_ms);
                                 }
                             }
                         }
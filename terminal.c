@@ -7,10 +7,35 @@
 
 #include "terminal.h"
 
-#include <stdio.h>
 #include <string.h>
+
+#if TERMINAL_CONFIG_PRINTF
+#include <stdio.h>
 #include <stdarg.h>
+#endif
+
+/* Sizes are folded into constants when fixed at compile time */
+#if TERMINAL_CONFIG_MAX_LINE_LEN > 0
+#define _MAX_LINE_LEN(p_terminal)               (TERMINAL_CONFIG_MAX_LINE_LEN)
+#define _HISTORY_ENTRY_MAX_LEN(p_history)       (TERMINAL_CONFIG_MAX_LINE_LEN)
+#else
+#define _MAX_LINE_LEN(p_terminal)               ((p_terminal)->max_line_len)
+#define _HISTORY_ENTRY_MAX_LEN(p_history)       ((p_history)->entry_max_len)
+#endif
 
+#if TERMINAL_CONFIG_HISTORY_MAX_ENTRIES > 0
+#define _HISTORY_MAX_ENTRIES(p_history)         (TERMINAL_CONFIG_HISTORY_MAX_ENTRIES)
+#else
+#define _HISTORY_MAX_ENTRIES(p_history)         ((p_history)->max_entries)
+#endif
+
+/* Async line budget is counted in thousandths of a line, so it can be refilled every millisecond */
+#define _ASYNC_LINE_COST                        1000U
+#define _ASYNC_LINE_BUDGET_MAX                  (TERMINAL_ASYNC_MAX_LINES_PER_PROCESS * _ASYNC_LINE_COST)
+
+#define _HISTORY_ENTRY(p_history, entry_idx)    (&(p_history)->p_entries[(entry_idx) * (_HISTORY_ENTRY_MAX_LEN(p_history) + 1)])
+
+#if TERMINAL_CONFIG_HISTORY
 static void _history_init(Terminal_History_t *p_history, char *p_entries, int max_entries, int entry_max_len)
 {
     p_history->p_entries = p_entries;
@@ -31,15 +56,15 @@ static void _history_add_entry(Terminal_History_t *p_history, char *p_entry)
     }
     else
     {
-        new_entry_idx = (p_history->last_entry_idx + 1) % p_history->max_entries;
+        new_entry_idx = (p_history->last_entry_idx + 1) % _HISTORY_MAX_ENTRIES(p_history);
     }
 
-    if (p_history->number_of_entries < p_history->max_entries)
+    if (p_history->number_of_entries < _HISTORY_MAX_ENTRIES(p_history))
     {
         p_history->number_of_entries++;
     }
 
-    strcpy(&p_history->p_entries[new_entry_idx * (p_history->entry_max_len + 1)], p_entry);
+    strcpy(_HISTORY_ENTRY(p_history, new_entry_idx), p_entry);
     p_history->last_entry_idx = new_entry_idx;
 }
 
@@ -51,7 +76,7 @@ static int _history_get_entry_idx_by_entry_no(Terminal_History_t *p_history, int
     {
         if (p_history->last_entry_idx - entry_no < 0)
         {
-            entry_idx = p_history->max_entries - (entry_no - p_history->last_entry_idx);
+            entry_idx = _HISTORY_MAX_ENTRIES(p_history) - (entry_no - p_history->last_entry_idx);
         }
         else
         {
@@ -61,6 +86,7 @@ static int _history_get_entry_idx_by_entry_no(Terminal_History_t *p_history, int
     return entry_idx;
 }
 
+#if TERMINAL_CONFIG_VT100
 static char *_history_pick_older_entry(Terminal_History_t *p_history)
 {
     char *p_entry = NULL;
@@ -77,7 +103,7 @@ static char *_history_pick_older_entry(Terminal_History_t *p_history)
 
         if (-1 != entry_to_display_idx)
         {
-            p_entry = &p_history->p_entries[entry_to_display_idx * (p_history->entry_max_len + 1)];
+            p_entry = _HISTORY_ENTRY(p_history, entry_to_display_idx);
         }
     }
 
@@ -101,210 +127,797 @@ static char *_history_pick_newer_entry(Terminal_History_t *p_history)
 
     if (-1 != entry_to_display_idx)
     {
-        p_entry = &p_history->p_entries[entry_to_display_idx * (p_history->entry_max_len + 1)];
+        p_entry = _HISTORY_ENTRY(p_history, entry_to_display_idx);
     }
 
     return p_entry;
 }
+#endif
 
 static void _history_reset_displayed_entry_no(Terminal_History_t *p_history)
 {
     p_history->displayed_entry_no = -1;
 }
+#endif
 
-void terminal_init(Terminal_t *p_terminal,
-                   char *p_line_buffer,
-                   int max_line_len,
-                   char *p_write_buffer,
-                   int write_buffer_size,
-                   char *p_history_entries,
-                   int history_max_entries,
-                   Terminal_On_Write_Request_t on_write_request,
-                   Terminal_On_Line_Read_t on_line_read,
-                   Terminal_On_Suggestion_Request_t on_suggestion_request)
+#if TERMINAL_CONFIG_ASYNC
+static void _async_queue_init(Terminal_Async_Queue_t *p_queue, Terminal_Async_Entry_t *p_entries, int number_of_entries)
 {
-    p_terminal->p_line_buffer = p_line_buffer;
-    p_terminal->p_line_buffer[0] = '\0';
-    p_terminal->max_line_len = max_line_len;
-    p_terminal->current_line_len = 0;
-    p_terminal->cursor_pos = 0;
-    p_terminal->p_write_buffer = p_write_buffer;
-    p_terminal->write_buffer_size = write_buffer_size;
-    p_terminal->received_vt100_sequence_len = 0;
-    p_terminal->on_write_request = on_write_request;
-    p_terminal->on_line_read = on_line_read;
-    p_terminal->on_suggestion_request = on_suggestion_request;
-    p_terminal->p_prompt = "";
-    p_terminal->echo_disabled = false;
+    for (int i = 0; i < number_of_entries; ++i)
+    {
+        atomic_init(&p_entries[i].sequence, (unsigned int) i);
+    }
 
-    _history_init(&p_terminal->history, p_history_entries, history_max_entries, max_line_len);
+    p_queue->p_entries = p_entries;
+    p_queue->mask = (unsigned int) number_of_entries - 1U;
+    atomic_init(&p_queue->enqueue_pos, 0U);
+    p_queue->dequeue_pos = 0U;
+    atomic_init(&p_queue->number_of_dropped, 0U);
+    p_queue->line_budget = _ASYNC_LINE_BUDGET_MAX;
 }
 
-void terminal_feed(Terminal_t *p_terminal, char byte)
+static void _async_queue_refill_line_budget(Terminal_Async_Queue_t *p_queue, unsigned int elapsed_ms)
 {
-    if ('\e' == byte)
+    if (elapsed_ms >= _ASYNC_LINE_BUDGET_MAX / TERMINAL_ASYNC_LINES_PER_SECOND)
     {
-        /* Escape character occurred - it's the start of VT100 sequence */
-        p_terminal->received_vt100_sequence[0] = byte;
-        p_terminal->received_vt100_sequence[1] = '\0';
-        p_terminal->received_vt100_sequence_len = 1;
+        p_queue->line_budget = _ASYNC_LINE_BUDGET_MAX;
     }
-    else if ('\r' == byte)
+    else
     {
-        /* User pressed ENTER - there is a new line to process */
-        if (p_terminal->current_line_len > 0)
+        p_queue->line_budget += elapsed_ms * TERMINAL_ASYNC_LINES_PER_SECOND;
+
+        if (p_queue->line_budget > _ASYNC_LINE_BUDGET_MAX)
         {
-            _history_add_entry(&p_terminal->history, p_terminal->p_line_buffer);
+            p_queue->line_budget = _ASYNC_LINE_BUDGET_MAX;
         }
-        _history_reset_displayed_entry_no(&p_terminal->history);
-        terminal_printf(p_terminal, "\r\n");
+    }
+}
 
-        /* Fire a callback to notify that a line was read */
-        p_terminal->on_line_read(p_terminal, p_terminal->p_line_buffer, p_terminal->current_line_len);
+static bool _async_queue_push(Terminal_Async_Queue_t *p_queue, const char *p_message)
+{
+    Terminal_Async_Entry_t *p_entry = NULL;
+    unsigned int pos = atomic_load_explicit(&p_queue->enqueue_pos, memory_order_relaxed);
 
-        /* Reset some variables, so next line can be read again */
-        p_terminal->p_line_buffer[0] = '\0';
-        p_terminal->current_line_len = 0;
-        p_terminal->cursor_pos = 0;
-        p_terminal->received_vt100_sequence_len = 0;
-        terminal_printf(p_terminal, "%s", p_terminal->p_prompt);
+    /* Claim a free entry - multiple producers compete for enqueue_pos */
+    while (NULL == p_entry)
+    {
+        Terminal_Async_Entry_t *p_candidate = &p_queue->p_entries[pos & p_queue->mask];
+        unsigned int sequence = atomic_load_explicit(&p_candidate->sequence, memory_order_acquire);
+        int diff = (int) (sequence - pos);
+
+        if (0 == diff)
+        {
+            if (atomic_compare_exchange_weak_explicit(&p_queue->enqueue_pos, &pos, pos + 1U, memory_order_relaxed, memory_order_relaxed))
+            {
+                p_entry = p_candidate;
+            }
+        }
+        else if (diff < 0)
+        {
+            /* Queue is full - consumer has not released this entry yet */
+            atomic_fetch_add_explicit(&p_queue->number_of_dropped, 1U, memory_order_relaxed);
+            return false;
+        }
+        else
+        {
+            pos = atomic_load_explicit(&p_queue->enqueue_pos, memory_order_relaxed);
+        }
     }
-    else if (TERMINAL_ASCII_END_OF_TEXT == byte)
+
+    int message_len = strlen(p_message);
+
+    if (message_len > TERMINAL_ASYNC_MESSAGE_MAX_LEN)
     {
-        /* User pressed CTRL+C - ignore line */
-        p_terminal->p_line_buffer[0] = '\0';
-        p_terminal->current_line_len = 0;
-        p_terminal->cursor_pos = 0;
-        p_terminal->received_vt100_sequence_len = 0;
-        terminal_printf(p_terminal, "\r\n%s", p_terminal->p_prompt);
+        message_len = TERMINAL_ASYNC_MESSAGE_MAX_LEN;
+    }
+    memcpy(p_entry->message, p_message, message_len);
+    p_entry->message[message_len] = '\0';
+    p_entry->message_len = message_len;
 
-        _history_reset_displayed_entry_no(&p_terminal->history);
+    /* Publish the entry to the consumer */
+    atomic_store_explicit(&p_entry->sequence, pos + 1U, memory_order_release);
+    return true;
+}
+
+static Terminal_Async_Entry_t *_async_queue_peek(Terminal_Async_Queue_t *p_queue)
+{
+    Terminal_Async_Entry_t *p_entry = &p_queue->p_entries[p_queue->dequeue_pos & p_queue->mask];
+    unsigned int sequence = atomic_load_explicit(&p_entry->sequence, memory_order_acquire);
+
+    if (sequence != p_queue->dequeue_pos + 1U)
+    {
+        p_entry = NULL;
     }
-    else if (p_terminal->received_vt100_sequence_len > 0)
+    return p_entry;
+}
+
+static void _async_queue_pop(Terminal_Async_Queue_t *p_queue)
+{
+    Terminal_Async_Entry_t *p_entry = &p_queue->p_entries[p_queue->dequeue_pos & p_queue->mask];
+
+    /* Hand the entry back to producers for the next lap */
+    atomic_store_explicit(&p_entry->sequence, p_queue->dequeue_pos + p_queue->mask + 1U, memory_order_release);
+    p_queue->dequeue_pos++;
+}
+#endif
+
+#if TERMINAL_CONFIG_HIBERNATION
+static void _buffer_pool_release(Terminal_Buffer_Pool_t *p_pool, char *p_slab)
+{
+    /* Free slabs are linked through their first bytes */
+    memcpy(p_slab, &p_pool->p_free_slabs, sizeof(char *));
+    p_pool->p_free_slabs = p_slab;
+    p_pool->number_of_free_slabs++;
+}
+
+static char *_buffer_pool_acquire(Terminal_Buffer_Pool_t *p_pool)
+{
+    char *p_slab = p_pool->p_free_slabs;
+
+    if (NULL != p_slab)
     {
-        /* VT100 sequence is started, so let's continue */
-        p_terminal->received_vt100_sequence[p_terminal->received_vt100_sequence_len] = byte;
-        p_terminal->received_vt100_sequence[p_terminal->received_vt100_sequence_len + 1] = '\0';
-        p_terminal->received_vt100_sequence_len++;
+        memcpy(&p_pool->p_free_slabs, p_slab, sizeof(char *));
+        p_pool->number_of_free_slabs--;
+    }
+    return p_slab;
+}
 
-        bool got_sequence = false;
+static char *_buffer_pool_get_history_entries(Terminal_Buffer_Pool_t *p_pool, char *p_slab)
+{
+    return &p_slab[p_pool->max_line_len + 1];
+}
 
-        /* Check if we already have received valid VT100 sequence */
-        if (0 == strcmp(p_terminal->received_vt100_sequence, TERMINAL_VT100_CURSOR_UP))
+static char *_buffer_pool_get_write_buffer(Terminal_Buffer_Pool_t *p_pool, char *p_slab)
+{
+    return &p_slab[(p_pool->history_max_entries + 1) * (p_pool->max_line_len + 1)];
+}
+
+static bool _blob_put_length(char *p_blob, int blob_size, int *p_pos, int length)
+{
+    bool fits = true;
+
+    /* 7 bits per byte, the highest bit is set when more bytes follow */
+    do
+    {
+        if (*p_pos < blob_size)
         {
-            /* User pressed ARROW UP - show older history entry */
-            char *p_history_entry = _history_pick_older_entry(&p_terminal->history);
+            p_blob[*p_pos] = (char) ((length & 0x7F) | ((length > 0x7F) ? 0x80 : 0x00));
+            (*p_pos)++;
+        }
+        else
+        {
+            fits = false;
+        }
+        length >>= 7;
+    } while (fits && length > 0);
 
-            if (NULL != p_history_entry)
-            {
-                terminal_printf(p_terminal, TERMINAL_VT100_ERASE_LINE "\r%s", p_terminal->p_prompt);
+    return fits;
+}
 
-                p_terminal->current_line_len = strlen(p_history_entry);
-                strcpy(p_terminal->p_line_buffer, p_history_entry);
-                p_terminal->cursor_pos = p_terminal->current_line_len;
+static bool _blob_put_data(char *p_blob, int blob_size, int *p_pos, const char *p_data, int data_len)
+{
+    bool fits = (*p_pos + data_len <= blob_size);
 
-                terminal_printf(p_terminal, p_terminal->p_line_buffer);
-            }
-            got_sequence = true;
+    if (fits)
+    {
+        memcpy(&p_blob[*p_pos], p_data, data_len);
+        *p_pos += data_len;
+    }
+    return fits;
+}
+
+static int _blob_get_length(const char *p_blob, int *p_pos)
+{
+    int length = 0;
+    int shift = 0;
+    unsigned char byte;
+
+    do
+    {
+        byte = (unsigned char) p_blob[*p_pos];
+        (*p_pos)++;
+        length |= (byte & 0x7F) << shift;
+        shift += 7;
+    } while (byte & 0x80);
+
+    return length;
+}
+
+static bool _hibernation_save(Terminal_t *p_terminal)
+{
+    char *p_blob = p_terminal->p_hibernation_blob;
+    int blob_size = p_terminal->hibernation_blob_size;
+    int pos = 0;
+    bool fits;
+
+#if TERMINAL_CONFIG_HISTORY
+    /* Last byte is kept for the end of history marker */
+    blob_size--;
+#endif
+
+    /* Line and cursor must always be stored, otherwise the session can't hibernate */
+    fits = (blob_size >= 0) &&
+           _blob_put_length(p_blob, blob_size, &pos, p_terminal->current_line_len) &&
+           _blob_put_length(p_blob, blob_size, &pos, p_terminal->cursor_pos) &&
+           _blob_put_data(p_blob, blob_size, &pos, p_terminal->p_line_buffer, p_terminal->current_line_len);
+
+#if TERMINAL_CONFIG_HISTORY
+    Terminal_History_t *p_history = &p_terminal->history;
+    int number_of_saved_entries = 0;
+#if TERMINAL_CONFIG_HIBERNATION_COMPRESSION
+    char *p_previous_entry = "";
+#endif
+
+    fits = fits && _blob_put_length(p_blob, blob_size, &pos, p_history->displayed_entry_no + 1);
+
+    /* Newest entry first, so when the blob is full only the oldest entries are dropped */
+    for (int entry_no = 0; fits && entry_no < p_history->number_of_entries; ++entry_no)
+    {
+        char *p_entry = _HISTORY_ENTRY(p_history, _history_get_entry_idx_by_entry_no(p_history, entry_no));
+        int entry_len = strlen(p_entry);
+        int prefix_len = 0;
+        int entry_pos = pos;
+        bool entry_fits;
+
+#if TERMINAL_CONFIG_HIBERNATION_COMPRESSION
+        /* Consecutive commands often differ only in arguments - store only what differs */
+        while ((prefix_len < entry_len) && (p_entry[prefix_len] == p_previous_entry[prefix_len]))
+        {
+            prefix_len++;
         }
-        else if (0 == strcmp(p_terminal->received_vt100_sequence, TERMINAL_VT100_CURSOR_DOWN))
+#endif
+
+        /* Length is stored increased by one, as zero marks the end of history */
+        entry_fits = _blob_put_length(p_blob, blob_size, &pos, entry_len - prefix_len + 1);
+
+#if TERMINAL_CONFIG_HIBERNATION_COMPRESSION
+        entry_fits = entry_fits && _blob_put_length(p_blob, blob_size, &pos, prefix_len);
+#endif
+
+        entry_fits = entry_fits && _blob_put_data(p_blob, blob_size, &pos, &p_entry[prefix_len], entry_len - prefix_len);
+
+        if (entry_fits)
+        {
+            number_of_saved_entries++;
+#if TERMINAL_CONFIG_HIBERNATION_COMPRESSION
+            p_previous_entry = p_entry;
+#endif
+        }
+        else
         {
-            /* User pressed ARROW DOWN - show newer history entry */
-            char *p_history_entry = _history_pick_newer_entry(&p_terminal->history);
+            /* This and older entries are dropped */
+            pos = entry_pos;
+            break;
+        }
+    }
 
-            terminal_printf(p_terminal, TERMINAL_VT100_ERASE_LINE "\r%s", p_terminal->p_prompt);
+    if (fits)
+    {
+        p_blob[pos] = 0;
+        p_history->number_of_entries = number_of_saved_entries;
+    }
+#endif
 
-            if (NULL == p_history_entry)
-            {
-                p_terminal->current_line_len = 0;
-                p_terminal->cursor_pos = 0;
-            }
-            else
-            {
-                p_terminal->current_line_len = strlen(p_history_entry);
-                strcpy(p_terminal->p_line_buffer, p_history_entry);
-                p_terminal->cursor_pos = p_terminal->current_line_len;
+    return fits;
+}
 
-                terminal_printf(p_terminal, p_terminal->p_line_buffer);
-            }
-            got_sequence = true;
+static void _hibernation_load(Terminal_t *p_terminal)
+{
+    char *p_blob = p_terminal->p_hibernation_blob;
+    int pos = 0;
+
+    p_terminal->current_line_len = _blob_get_length(p_blob, &pos);
+    p_terminal->cursor_pos = _blob_get_length(p_blob, &pos);
+    memcpy(p_terminal->p_line_buffer, &p_blob[pos], p_terminal->current_line_len);
+    p_terminal->p_line_buffer[p_terminal->current_line_len] = '\0';
+    pos += p_terminal->current_line_len;
+
+#if TERMINAL_CONFIG_HISTORY
+    Terminal_History_t *p_history = &p_terminal->history;
+    int max_entries = _HISTORY_MAX_ENTRIES(p_history);
+#if TERMINAL_CONFIG_HIBERNATION_COMPRESSION
+    int previous_entry_idx = 0;
+#endif
+
+    p_history->displayed_entry_no = _blob_get_length(p_blob, &pos) - 1;
+    p_history->number_of_entries = 0;
+
+    /* Newest entry goes to index 0, older ones backwards from the end, as if the history had wrapped */
+    p_history->last_entry_idx = 0;
+
+    int stored_len = _blob_get_length(p_blob, &pos);
+
+    while (stored_len > 0)
+    {
+        int entry_idx = (max_entries - p_history->number_of_entries) % max_entries;
+        char *p_entry = _HISTORY_ENTRY(p_history, entry_idx);
+        int suffix_len = stored_len - 1;
+        int prefix_len = 0;
+
+#if TERMINAL_CONFIG_HIBERNATION_COMPRESSION
+        prefix_len = _blob_get_length(p_blob, &pos);
+
+        if (prefix_len > 0)
+        {
+            memcpy(p_entry, _HISTORY_ENTRY(p_history, previous_entry_idx), prefix_len);
         }
-        else if (0 == strcmp(p_terminal->received_vt100_sequence, TERMINAL_VT100_CURSOR_FORWARD))
+        previous_entry_idx = entry_idx;
+#endif
+
+        memcpy(&p_entry[prefix_len], &p_blob[pos], suffix_len);
+        p_entry[prefix_len + suffix_len] = '\0';
+        pos += suffix_len;
+
+        p_history->number_of_entries++;
+        stored_len = _blob_get_length(p_blob, &pos);
+    }
+
+    /* Displayed entry could be one of the dropped ones */
+    if (p_history->displayed_entry_no >= p_history->number_of_entries)
+    {
+        p_history->displayed_entry_no = p_history->number_of_entries - 1;
+    }
+#endif
+}
+
+#if TERMINAL_CONFIG_ASYNC
+static const char *_hibernation_peek_line(Terminal_t *p_terminal, int *p_line_len, int *p_cursor_pos)
+{
+    char *p_blob = p_terminal->p_hibernation_blob;
+    int pos = 0;
+
+    /* Line and cursor are stored first, so they are read without restoring the session */
+    *p_line_len = _blob_get_length(p_blob, &pos);
+    *p_cursor_pos = _blob_get_length(p_blob, &pos);
+
+    return &p_blob[pos];
+}
+#endif
+
+static bool _wake_up(Terminal_t *p_terminal)
+{
+    bool awake = true;
+
+    if (p_terminal->hibernated)
+    {
+        char *p_slab = _buffer_pool_acquire(p_terminal->p_buffer_pool);
+
+        if (NULL == p_slab)
         {
-            /* User pressed RIGHT ARROW - move cursor forward */
-            if (p_terminal->cursor_pos < p_terminal->current_line_len)
+            /* Pool exhausted - stay hibernated until some slab is released */
+            awake = false;
+        }
+        else
+        {
+            p_terminal->p_line_buffer = p_slab;
+            p_terminal->p_write_buffer = _buffer_pool_get_write_buffer(p_terminal->p_buffer_pool, p_slab);
+#if TERMINAL_CONFIG_HISTORY
+            p_terminal->history.p_entries = _buffer_pool_get_history_entries(p_terminal->p_buffer_pool, p_slab);
+#endif
+            _hibernation_load(p_terminal);
+
+            p_terminal->hibernated = false;
+            p_terminal->idle_time_ms = 0;
+        }
+    }
+    return awake;
+}
+#else
+#define _wake_up(p_terminal)    (true)
+#endif
+
+static void _flush(Terminal_t *p_terminal)
+{
+    if (p_terminal->write_buffer_len > 0)
+    {
+        p_terminal->on_write_request(p_terminal, p_terminal->p_write_buffer, p_terminal->write_buffer_len);
+        p_terminal->write_buffer_len = 0;
+    }
+}
+
+static void _write(Terminal_t *p_terminal, const char *p_data, int data_len)
+{
+    if (!p_terminal->echo_disabled && data_len > 0)
+    {
+        if ((NULL == p_terminal->p_write_buffer) || (0 == p_terminal->write_buffer_size))
+        {
+            /* No buffer to collect output in - pass it directly */
+            p_terminal->on_write_request(p_terminal, (char *) p_data, data_len);
+        }
+        else
+        {
+            /* Output is collected and sent at once by _flush() at the end of every operation */
+            while (data_len > 0)
             {
-                p_terminal->cursor_pos++;
-                terminal_printf(p_terminal, TERMINAL_VT100_CURSOR_FORWARD);
+                int chunk_len = p_terminal->write_buffer_size - p_terminal->write_buffer_len;
+
+                if (chunk_len > data_len)
+                {
+                    chunk_len = data_len;
+                }
+                memcpy(&p_terminal->p_write_buffer[p_terminal->write_buffer_len], p_data, chunk_len);
+                p_terminal->write_buffer_len += chunk_len;
+                p_data += chunk_len;
+                data_len -= chunk_len;
+
+                if (p_terminal->write_buffer_len == p_terminal->write_buffer_size)
+                {
+                    _flush(p_terminal);
+                }
             }
-            got_sequence = true;
         }
-        else if (0 == strcmp(p_terminal->received_vt100_sequence, TERMINAL_VT100_CURSOR_BACKWARD))
+    }
+}
+
+static void _write_string(Terminal_t *p_terminal, const char *p_string)
+{
+    _write(p_terminal, p_string, strlen(p_string));
+}
+
+static int _format_number(char *p_buffer, unsigned int number)
+{
+    char digits[10];
+    int number_of_digits = 0;
+
+    do
+    {
+        digits[number_of_digits++] = '0' + number % 10U;
+        number /= 10U;
+    } while (number > 0U);
+
+    for (int i = 0; i < number_of_digits; ++i)
+    {
+        p_buffer[i] = digits[number_of_digits - i - 1];
+    }
+    return number_of_digits;
+}
+
+#if TERMINAL_CONFIG_ASYNC
+static void _write_number(Terminal_t *p_terminal, unsigned int number)
+{
+    char buffer[10];
+
+    _write(p_terminal, buffer, _format_number(buffer, number));
+}
+#endif
+
+static void _write_cursor_move(Terminal_t *p_terminal, int distance, char direction)
+{
+    /* ESC [ <distance> <direction> */
+    char sequence[2 + 10 + 1];
+    int sequence_len = 0;
+
+    sequence[sequence_len++] = '\e';
+    sequence[sequence_len++] = '[';
+    sequence_len += _format_number(&sequence[sequence_len], distance);
+    sequence[sequence_len++] = direction;
+
+    _write(p_terminal, sequence, sequence_len);
+}
+
+static void _redraw(Terminal_t *p_terminal, const char *p_line, int line_len, int cursor_pos)
+{
+    _write_string(p_terminal, TERMINAL_VT100_ERASE_LINE "\r");
+    _write_string(p_terminal, p_terminal->p_prompt);
+    _write(p_terminal, p_line, line_len);
+
+    if (cursor_pos < line_len)
+    {
+        _write_cursor_move(p_terminal, line_len - cursor_pos, 'D');
+    }
+}
+
+static void _redraw_line(Terminal_t *p_terminal)
+{
+    _redraw(p_terminal, p_terminal->p_line_buffer, p_terminal->current_line_len, p_terminal->cursor_pos);
+}
+
+#if TERMINAL_CONFIG_HISTORY && TERMINAL_CONFIG_VT100
+static void _show_history_entry(Terminal_t *p_terminal, char *p_history_entry)
+{
+    if (NULL == p_history_entry)
+    {
+        p_terminal->p_line_buffer[0] = '\0';
+        p_terminal->current_line_len = 0;
+    }
+    else
+    {
+        p_terminal->current_line_len = strlen(p_history_entry);
+        strcpy(p_terminal->p_line_buffer, p_history_entry);
+    }
+    p_terminal->cursor_pos = p_terminal->current_line_len;
+
+    _redraw_line(p_terminal);
+}
+#endif
+
+#if TERMINAL_CONFIG_VT100
+static void _handle_vt100_sequence(Terminal_t *p_terminal)
+{
+    char *p_sequence = p_terminal->received_vt100_sequence;
+    int sequence_len = p_terminal->received_vt100_sequence_len;
+
+    /* Dispatch on the final byte, so only complete sequences are compared */
+    switch ((3 == sequence_len) ? p_sequence[2] : '\0')
+    {
+#if TERMINAL_CONFIG_HISTORY
+    case 'A':
+        /* User pressed ARROW UP - show older history entry */
         {
-            /* User pressed LEFT ARROW - move cursor backward */
-            if (p_terminal->cursor_pos > 0)
+            char *p_history_entry = _history_pick_older_entry(&p_terminal->history);
+
+            if (NULL != p_history_entry)
             {
-                p_terminal->cursor_pos--;
-                terminal_printf(p_terminal, TERMINAL_VT100_CURSOR_BACKWARD);
+                _show_history_entry(p_terminal, p_history_entry);
             }
-            got_sequence = true;
         }
-        else if (0 == strcmp(p_terminal->received_vt100_sequence, TERMINAL_VT100_CURSOR_DELETE))
+        break;
+
+    case 'B':
+        /* User pressed ARROW DOWN - show newer history entry */
+        _show_history_entry(p_terminal, _history_pick_newer_entry(&p_terminal->history));
+        break;
+#endif
+
+    case 'C':
+        /* User pressed RIGHT ARROW - move cursor forward */
+        if (p_terminal->cursor_pos < p_terminal->current_line_len)
+        {
+            p_terminal->cursor_pos++;
+            _write_string(p_terminal, TERMINAL_VT100_CURSOR_FORWARD);
+        }
+        break;
+
+    case 'D':
+        /* User pressed LEFT ARROW - move cursor backward */
+        if (p_terminal->cursor_pos > 0)
+        {
+            p_terminal->cursor_pos--;
+            _write_string(p_terminal, TERMINAL_VT100_CURSOR_BACKWARD);
+        }
+        break;
+
+    default:
+        break;
+    }
+
+    if ((4 == sequence_len) && ('~' == p_sequence[3]))
+    {
+        switch (p_sequence[2])
         {
+        case '3':
             /* User pressed DELETE - remove character in front of cursor */
             if (p_terminal->cursor_pos < p_terminal->current_line_len)
             {
-                terminal_printf(p_terminal, TERMINAL_VT100_ERASE_END_OF_LINE);
+                _write_string(p_terminal, TERMINAL_VT100_ERASE_END_OF_LINE);
 
                 if (p_terminal->cursor_pos < p_terminal->current_line_len - 1)
                 {
                     memmove(&p_terminal->p_line_buffer[p_terminal->cursor_pos], &p_terminal->p_line_buffer[p_terminal->cursor_pos + 1], p_terminal->current_line_len - p_terminal->cursor_pos);
 
-                    terminal_printf(p_terminal, &p_terminal->p_line_buffer[p_terminal->cursor_pos]);
-                    terminal_printf(p_terminal, "\e[%dD", p_terminal->current_line_len - p_terminal->cursor_pos - 1);
+                    _write_string(p_terminal, &p_terminal->p_line_buffer[p_terminal->cursor_pos]);
+                    _write_cursor_move(p_terminal, p_terminal->current_line_len - p_terminal->cursor_pos - 1, 'D');
+                }
+                else
+                {
+                    p_terminal->p_line_buffer[p_terminal->cursor_pos] = '\0';
                 }
 
                 p_terminal->current_line_len--;
             }
-            got_sequence = true;
-        }
-        else if (0 == strcmp(p_terminal->received_vt100_sequence, TERMINAL_VT100_CURSOR_HOME))
-        {
+            break;
+
+        case '1':
             /* User pressed HOME - move cursor to the beginning of the line */
             if (p_terminal->cursor_pos > 0)
             {
-                terminal_printf(p_terminal, "\e[%dD", p_terminal->cursor_pos);
+                _write_cursor_move(p_terminal, p_terminal->cursor_pos, 'D');
                 p_terminal->cursor_pos = 0;
             }
-            got_sequence = true;
-        }
-        else if (0 == strcmp(p_terminal->received_vt100_sequence, TERMINAL_VT100_CURSOR_END))
-        {
+            break;
+
+        case '4':
             /* User pressed END - move cursor to the end of the line */
             if (p_terminal->cursor_pos < p_terminal->current_line_len)
             {
-                terminal_printf(p_terminal, "\e[%dC", p_terminal->current_line_len - p_terminal->cursor_pos);
+                _write_cursor_move(p_terminal, p_terminal->current_line_len - p_terminal->cursor_pos, 'C');
                 p_terminal->cursor_pos = p_terminal->current_line_len;
             }
-            got_sequence = true;
-        }
-        else if ('~' == p_terminal->received_vt100_sequence[p_terminal->received_vt100_sequence_len - 1])
-        {
+            break;
+
+        default:
             /* User pressed special key like F1-F12, INSERT and so on - ignore it */
-            got_sequence = true;
+            break;
         }
+    }
+}
+#endif
+
+static void _feed_vt100_sequence(Terminal_t *p_terminal, char byte)
+{
+    bool got_sequence;
+
+#if TERMINAL_CONFIG_VT100
+    p_terminal->received_vt100_sequence[p_terminal->received_vt100_sequence_len] = byte;
+    p_terminal->received_vt100_sequence[p_terminal->received_vt100_sequence_len + 1] = '\0';
+#endif
+    p_terminal->received_vt100_sequence_len++;
+
+    if (2 == p_terminal->received_vt100_sequence_len)
+    {
+        /* Anything but CSI or SS3 introducer is a complete two byte sequence */
+        got_sequence = ('[' != byte) && ('O' != byte);
+    }
+    else
+    {
+        /* Sequence ends with a final byte, parameters are digits and separators */
+        got_sequence = (byte >= '@') && (byte <= '~');
+    }
+
+    if (got_sequence)
+    {
+#if TERMINAL_CONFIG_VT100
+        _handle_vt100_sequence(p_terminal);
+#endif
+        p_terminal->received_vt100_sequence_len = 0;
+    }
+    else if (p_terminal->received_vt100_sequence_len >= TERMINAL_VT100_SEQUENCE_MAX_LEN)
+    {
+        /* Sequence too long to be valid - drop it */
+        p_terminal->received_vt100_sequence_len = 0;
+    }
+}
+
+bool terminal_init(Terminal_t *p_terminal,
+                   char *p_line_buffer,
+                   int max_line_len,
+                   char *p_write_buffer,
+                   int write_buffer_size,
+                   char *p_history_entries,
+                   int history_max_entries,
+                   Terminal_On_Write_Request_t on_write_request,
+                   Terminal_On_Line_Read_t on_line_read,
+                   Terminal_On_Suggestion_Request_t on_suggestion_request)
+{
+    bool valid = true;
+
+    /* Sizes fixed at compile time must match buffers provided by the caller */
+#if TERMINAL_CONFIG_MAX_LINE_LEN > 0
+    valid = valid && (TERMINAL_CONFIG_MAX_LINE_LEN == max_line_len);
+#endif
+#if TERMINAL_CONFIG_HISTORY && TERMINAL_CONFIG_HISTORY_MAX_ENTRIES > 0
+    valid = valid && (TERMINAL_CONFIG_HISTORY_MAX_ENTRIES == history_max_entries);
+#endif
+
+    if (valid)
+    {
+        p_terminal->p_line_buffer = p_line_buffer;
+        p_terminal->p_line_buffer[0] = '\0';
+        p_terminal->max_line_len = max_line_len;
+        p_terminal->current_line_len = 0;
+        p_terminal->cursor_pos = 0;
+        p_terminal->p_write_buffer = p_write_buffer;
+        p_terminal->write_buffer_size = write_buffer_size;
+        p_terminal->write_buffer_len = 0;
+        p_terminal->received_vt100_sequence_len = 0;
+        p_terminal->on_write_request = on_write_request;
+        p_terminal->on_line_read = on_line_read;
+        p_terminal->p_prompt = "";
+        p_terminal->echo_disabled = false;
+
+#if TERMINAL_CONFIG_SUGGESTIONS
+        p_terminal->on_suggestion_request = on_suggestion_request;
+#else
+        (void) on_suggestion_request;
+#endif
+
+#if TERMINAL_CONFIG_ASYNC
+        p_terminal->async_queue.p_entries = NULL;
+#endif
+
+#if TERMINAL_CONFIG_HIBERNATION
+        p_terminal->p_buffer_pool = NULL;
+        p_terminal->p_hibernation_blob = NULL;
+        p_terminal->hibernation_blob_size = 0;
+        p_terminal->idle_timeout_ms = 0;
+        p_terminal->idle_time_ms = 0;
+        p_terminal->hibernated = false;
+        p_terminal->in_callback = false;
+#endif
+
+#if TERMINAL_CONFIG_HISTORY
+        _history_init(&p_terminal->history, p_history_entries, history_max_entries, max_line_len);
+#else
+        (void) p_history_entries;
+        (void) history_max_entries;
+#endif
+    }
+    return valid;
+}
+
+bool terminal_feed(Terminal_t *p_terminal, char byte)
+{
+    bool fed = true;
+
+#if TERMINAL_CONFIG_HIBERNATION
+    p_terminal->idle_time_ms = 0;
+#endif
 
-        if (got_sequence)
+    if (!_wake_up(p_terminal))
+    {
+        /* No buffers to restore the session into - caller keeps the byte and retries later */
+        fed = false;
+    }
+    else if ('\e' == byte)
+    {
+        /* Escape character occurred - it's the start of VT100 sequence */
+#if TERMINAL_CONFIG_VT100
+        p_terminal->received_vt100_sequence[0] = byte;
+        p_terminal->received_vt100_sequence[1] = '\0';
+#endif
+        p_terminal->received_vt100_sequence_len = 1;
+    }
+    else if ('\r' == byte)
+    {
+        /* User pressed ENTER - there is a new line to process */
+#if TERMINAL_CONFIG_HISTORY
+        if (p_terminal->current_line_len > 0)
         {
-            p_terminal->received_vt100_sequence_len = 0;
+            _history_add_entry(&p_terminal->history, p_terminal->p_line_buffer);
         }
+        _history_reset_displayed_entry_no(&p_terminal->history);
+#endif
+        _write_string(p_terminal, "\r\n");
+
+        /* Fire a callback to notify that a line was read - echo goes out before its output */
+        _flush(p_terminal);
+#if TERMINAL_CONFIG_HIBERNATION
+        p_terminal->in_callback = true;
+#endif
+        p_terminal->on_line_read(p_terminal, p_terminal->p_line_buffer, p_terminal->current_line_len);
+#if TERMINAL_CONFIG_HIBERNATION
+        p_terminal->in_callback = false;
+#endif
+
+        /* Reset some variables, so next line can be read again */
+        p_terminal->p_line_buffer[0] = '\0';
+        p_terminal->current_line_len = 0;
+        p_terminal->cursor_pos = 0;
+        p_terminal->received_vt100_sequence_len = 0;
+        _write_string(p_terminal, p_terminal->p_prompt);
     }
+    else if (TERMINAL_ASCII_END_OF_TEXT == byte)
+    {
+        /* User pressed CTRL+C - ignore line */
+        p_terminal->p_line_buffer[0] = '\0';
+        p_terminal->current_line_len = 0;
+        p_terminal->cursor_pos = 0;
+        p_terminal->received_vt100_sequence_len = 0;
+        _write_string(p_terminal, "\r\n");
+        _write_string(p_terminal, p_terminal->p_prompt);
+
+#if TERMINAL_CONFIG_HISTORY
+        _history_reset_displayed_entry_no(&p_terminal->history);
+#endif
+    }
+    else if (p_terminal->received_vt100_sequence_len > 0)
+    {
+        /* VT100 sequence is started, so let's continue */
+        _feed_vt100_sequence(p_terminal, byte);
+    }
+#if TERMINAL_CONFIG_SUGGESTIONS
     else if ('\t' == byte)
     {
         /* User pressed TAB - show suggestion */
         if (NULL != p_terminal->on_suggestion_request)
         {
+#if TERMINAL_CONFIG_HIBERNATION
+            p_terminal->in_callback = true;
+#endif
             char *p_suggestion = p_terminal->on_suggestion_request(p_terminal, p_terminal->p_line_buffer, p_terminal->current_line_len);
+#if TERMINAL_CONFIG_HIBERNATION
+            p_terminal->in_callback = false;
+#endif
 
             if (NULL != p_suggestion)
             {
@@ -312,26 +925,30 @@ void terminal_feed(Terminal_t *p_terminal, char byte)
                 p_terminal->current_line_len = strlen(p_suggestion);
                 p_terminal->cursor_pos = p_terminal->current_line_len;
 
-                terminal_printf(p_terminal, TERMINAL_VT100_ERASE_LINE "\r%s", p_terminal->p_prompt);
-                terminal_printf(p_terminal, p_terminal->p_line_buffer);
+                _redraw_line(p_terminal);
             }
         }
     }
+#endif
     else if (TERMINAL_ASCII_DELETE == byte)
     {
         /* User pressed BACKSPACE - delete character behind cursor*/
         if (p_terminal->cursor_pos > 0)
         {
-            terminal_printf(p_terminal, "%c", byte);
+            _write(p_terminal, &byte, 1);
 
             if (p_terminal->cursor_pos < p_terminal->current_line_len)
             {
                 memmove(&p_terminal->p_line_buffer[p_terminal->cursor_pos - 1], &p_terminal->p_line_buffer[p_terminal->cursor_pos], p_terminal->current_line_len - p_terminal->cursor_pos);
                 p_terminal->p_line_buffer[p_terminal->current_line_len - 1] = '\0';
 
-                terminal_printf(p_terminal, TERMINAL_VT100_ERASE_END_OF_LINE);
-                terminal_printf(p_terminal, &p_terminal->p_line_buffer[p_terminal->cursor_pos - 1]);
-                terminal_printf(p_terminal, "\e[%dD", p_terminal->current_line_len - p_terminal->cursor_pos);
+                _write_string(p_terminal, TERMINAL_VT100_ERASE_END_OF_LINE);
+                _write_string(p_terminal, &p_terminal->p_line_buffer[p_terminal->cursor_pos - 1]);
+                _write_cursor_move(p_terminal, p_terminal->current_line_len - p_terminal->cursor_pos, 'D');
+            }
+            else
+            {
+                p_terminal->p_line_buffer[p_terminal->cursor_pos - 1] = '\0';
             }
 
             p_terminal->current_line_len--;
@@ -341,14 +958,14 @@ void terminal_feed(Terminal_t *p_terminal, char byte)
     else
     {
         /* User pressed normal key - store it in the line buffer */
-        if (p_terminal->current_line_len < p_terminal->max_line_len)
+        if (p_terminal->current_line_len < _MAX_LINE_LEN(p_terminal))
         {
             if (p_terminal->cursor_pos == p_terminal->current_line_len)
             {
                 /* Cursor is at the end of line */
                 p_terminal->p_line_buffer[p_terminal->cursor_pos] = byte;
                 p_terminal->p_line_buffer[p_terminal->cursor_pos + 1] = '\0';
-                terminal_printf(p_terminal, "%c", byte);
+                _write(p_terminal, &byte, 1);
             }
             else
             {
@@ -357,28 +974,26 @@ void terminal_feed(Terminal_t *p_terminal, char byte)
                 p_terminal->p_line_buffer[p_terminal->cursor_pos] = byte;
                 p_terminal->p_line_buffer[p_terminal->current_line_len + 1] = '\0';
 
-                terminal_printf(p_terminal, &p_terminal->p_line_buffer[p_terminal->cursor_pos]);
-                terminal_printf(p_terminal, "\e[%dD", p_terminal->current_line_len - p_terminal->cursor_pos);
+                _write_string(p_terminal, &p_terminal->p_line_buffer[p_terminal->cursor_pos]);
+                _write_cursor_move(p_terminal, p_terminal->current_line_len - p_terminal->cursor_pos, 'D');
             }
             p_terminal->current_line_len++;
             p_terminal->cursor_pos++;
         }
     }
+
+    _flush(p_terminal);
+    return fed;
 }
 
 void terminal_set_prompt(Terminal_t *p_terminal, char *p_prompt)
 {
     p_terminal->p_prompt = p_prompt;
 
-    terminal_printf(p_terminal, TERMINAL_VT100_ERASE_LINE "\r%s", p_terminal->p_prompt);
-
-    if (p_terminal->current_line_len > 0)
-    {
-        terminal_printf(p_terminal, p_terminal->p_line_buffer);
-    }
-    if (p_terminal->cursor_pos < p_terminal->current_line_len)
+    if (_wake_up(p_terminal))
     {
-        terminal_printf(p_terminal, "\e[%dD", p_terminal->current_line_len - p_terminal->cursor_pos);
+        _redraw_line(p_terminal);
+        _flush(p_terminal);
     }
 }
 
@@ -387,17 +1002,42 @@ void terminal_set_echo_disabled(Terminal_t *p_terminal, bool disabled)
     p_terminal->echo_disabled = disabled;
 }
 
+int terminal_write(Terminal_t *p_terminal, const char *p_data, int data_len)
+{
+    int result = 0;
+
+    /* Send what's collected first, so the order of output is kept */
+    _flush(p_terminal);
+
+    if (!p_terminal->echo_disabled && data_len > 0)
+    {
+        result = p_terminal->on_write_request(p_terminal, (char *) p_data, data_len);
+    }
+    return result;
+}
+
+#if TERMINAL_CONFIG_PRINTF
 int terminal_printf(Terminal_t *p_terminal, const char *p_format, ...)
 {
     int result = 0;
 
-    if (!p_terminal->echo_disabled)
+    if (!p_terminal->echo_disabled && _wake_up(p_terminal))
     {
         va_list args;
+
+        /* Write buffer is reused for formatting, so send what's collected first */
+        _flush(p_terminal);
+
         va_start(args, p_format);
-        int result = vsnprintf(p_terminal->p_write_buffer, p_terminal->write_buffer_size, p_format, args);
+        result = vsnprintf(p_terminal->p_write_buffer, p_terminal->write_buffer_size, p_format, args);
         va_end(args);
 
+        if (result >= p_terminal->write_buffer_size)
+        {
+            /* Output was truncated by vsnprintf */
+            result = p_terminal->write_buffer_size - 1;
+        }
+
         if (result > 0)
         {
             result = p_terminal->on_write_request(p_terminal, p_terminal->p_write_buffer, result);
@@ -405,26 +1045,300 @@ int terminal_printf(Terminal_t *p_terminal, const char *p_format, ...)
     }
     return result;
 }
+#endif
 
+#if TERMINAL_CONFIG_HISTORY
 int terminal_get_number_of_history_entries(Terminal_t *p_terminal)
 {
+    /* Kept in Terminal_t also while hibernated, so no need to restore the session */
     return p_terminal->history.number_of_entries;
 }
 
 char *terminal_get_history_entry(Terminal_t *p_terminal, int entry_no)
 {
     char *p_entry = NULL;
-    int entry_idx = _history_get_entry_idx_by_entry_no(&p_terminal->history, entry_no);
 
-    if (entry_idx != -1)
+    if (_wake_up(p_terminal))
     {
-        p_entry = &p_terminal->history.p_entries[entry_idx * (p_terminal->history.entry_max_len + 1)];
+        int entry_idx = _history_get_entry_idx_by_entry_no(&p_terminal->history, entry_no);
+
+        if (entry_idx != -1)
+        {
+            p_entry = _HISTORY_ENTRY(&p_terminal->history, entry_idx);
+        }
     }
     return p_entry;
 }
 
 void terminal_clear_history(Terminal_t *p_terminal)
 {
-    p_terminal->history.number_of_entries = 0;
-    p_terminal->history.displayed_entry_no = -1;
+    if (_wake_up(p_terminal))
+    {
+        p_terminal->history.number_of_entries = 0;
+        p_terminal->history.displayed_entry_no = -1;
+    }
+}
+#endif
+
+#if TERMINAL_CONFIG_ASYNC
+bool terminal_set_async_queue(Terminal_t *p_terminal, Terminal_Async_Entry_t *p_entries, int number_of_entries)
+{
+    /* Entry index is taken from position with a mask, so only powers of two are valid */
+    bool valid = (number_of_entries > 0) && (0 == (number_of_entries & (number_of_entries - 1)));
+
+    if (valid)
+    {
+        _async_queue_init(&p_terminal->async_queue, p_entries, number_of_entries);
+    }
+    return valid;
+}
+
+bool terminal_post_async(Terminal_t *p_terminal, const char *p_message)
+{
+    bool posted = false;
+
+    if (NULL != p_terminal->async_queue.p_entries)
+    {
+        posted = _async_queue_push(&p_terminal->async_queue, p_message);
+    }
+    return posted;
+}
+
+int terminal_process_async(Terminal_t *p_terminal, unsigned int elapsed_ms)
+{
+    Terminal_Async_Queue_t *p_queue = &p_terminal->async_queue;
+    int number_of_processed = 0;
+
+    if (NULL != p_queue->p_entries)
+    {
+        _async_queue_refill_line_budget(p_queue, elapsed_ms);
+    }
+
+    /* With echo disabled messages stay queued, so they are not lost while e.g. a password is typed */
+    if ((NULL != p_queue->p_entries) && !p_terminal->echo_disabled && (p_queue->line_budget >= _ASYNC_LINE_COST))
+    {
+        Terminal_Async_Entry_t *p_entry = _async_queue_peek(p_queue);
+
+        if (NULL != p_entry || 0U != atomic_load_explicit(&p_queue->number_of_dropped, memory_order_relaxed))
+        {
+            const char *p_line = p_terminal->p_line_buffer;
+            int line_len = p_terminal->current_line_len;
+            int cursor_pos = p_terminal->cursor_pos;
+
+#if TERMINAL_CONFIG_HIBERNATION
+            /*
+             * Hibernated session is not restored, as it would take a slab from the pool
+             * for every idle session a message is broadcast to - output is collected on
+             * the stack instead and the line is redrawn straight from the blob
+             */
+            char hibernated_write_buffer[TERMINAL_ASYNC_MESSAGE_MAX_LEN + 16];
+
+            if (p_terminal->hibernated)
+            {
+                p_terminal->p_write_buffer = hibernated_write_buffer;
+                p_terminal->write_buffer_size = sizeof(hibernated_write_buffer);
+                p_line = _hibernation_peek_line(p_terminal, &line_len, &cursor_pos);
+            }
+#endif
+
+            /* Erase the line being typed, so messages are not mixed with it */
+            _write_string(p_terminal, TERMINAL_VT100_ERASE_LINE "\r");
+
+            unsigned int number_of_dropped = atomic_exchange_explicit(&p_queue->number_of_dropped, 0U, memory_order_relaxed);
+
+            if (number_of_dropped > 0U)
+            {
+                _write_string(p_terminal, "<");
+                _write_number(p_terminal, number_of_dropped);
+                _write_string(p_terminal, " messages dropped>\r\n");
+                p_queue->line_budget -= _ASYNC_LINE_COST;
+            }
+
+            /*
+             * Limit lines by the budget, so a log storm can't flood the session, and entries
+             * per call, so producers refilling the queue while it's drained can't starve keystroke handling
+             */
+            int max_processed = (int) p_queue->mask + 1;
+
+            while ((NULL != p_entry) && (p_queue->line_budget >= _ASYNC_LINE_COST) && (number_of_processed < max_processed))
+            {
+                char message[TERMINAL_ASYNC_MESSAGE_MAX_LEN + 1];
+                int message_len = p_entry->message_len;
+                int number_of_repeats = 1;
+
+                memcpy(message, p_entry->message, message_len + 1);
+                _async_queue_pop(p_queue);
+                number_of_processed++;
+
+                /* Coalesce consecutive identical messages into a single line */
+                p_entry = _async_queue_peek(p_queue);
+
+                while ((NULL != p_entry) &&
+                       (number_of_processed < max_processed) &&
+                       (p_entry->message_len == message_len) &&
+                       (0 == memcmp(p_entry->message, message, message_len)))
+                {
+                    _async_queue_pop(p_queue);
+                    number_of_processed++;
+                    number_of_repeats++;
+                    p_entry = _async_queue_peek(p_queue);
+                }
+
+                _write(p_terminal, message, message_len);
+
+                if (number_of_repeats > 1)
+                {
+                    _write_string(p_terminal, " (x");
+                    _write_number(p_terminal, number_of_repeats);
+                    _write_string(p_terminal, ")");
+                }
+                _write_string(p_terminal, "\r\n");
+                p_queue->line_budget -= _ASYNC_LINE_COST;
+            }
+
+            /* Restore prompt, line and cursor position */
+            _redraw(p_terminal, p_line, line_len, cursor_pos);
+            _flush(p_terminal);
+
+#if TERMINAL_CONFIG_HIBERNATION
+            if (p_terminal->hibernated)
+            {
+                p_terminal->p_write_buffer = NULL;
+                p_terminal->write_buffer_size = p_terminal->p_buffer_pool->write_buffer_size;
+            }
+#endif
+        }
+    }
+    return number_of_processed;
+}
+#endif
+
+#if TERMINAL_CONFIG_HIBERNATION
+bool terminal_buffer_pool_init(Terminal_Buffer_Pool_t *p_pool,
+                               char *p_slabs,
+                               int number_of_slabs,
+                               int max_line_len,
+                               int write_buffer_size,
+                               int history_max_entries)
+{
+    int slab_size = TERMINAL_BUFFER_POOL_SLAB_SIZE(max_line_len, write_buffer_size, history_max_entries);
+    bool valid = (slab_size >= (int) sizeof(char *));
+
+    /* Slab layout must match sizes used to index the buffers when fixed at compile time */
+#if TERMINAL_CONFIG_MAX_LINE_LEN > 0
+    valid = valid && (TERMINAL_CONFIG_MAX_LINE_LEN == max_line_len);
+#endif
+#if TERMINAL_CONFIG_HISTORY && TERMINAL_CONFIG_HISTORY_MAX_ENTRIES > 0
+    valid = valid && (TERMINAL_CONFIG_HISTORY_MAX_ENTRIES == history_max_entries);
+#endif
+
+    p_pool->p_free_slabs = NULL;
+    p_pool->number_of_free_slabs = 0;
+    p_pool->max_line_len = max_line_len;
+    p_pool->write_buffer_size = write_buffer_size;
+    p_pool->history_max_entries = history_max_entries;
+
+    if (valid)
+    {
+        for (int i = 0; i < number_of_slabs; ++i)
+        {
+            _buffer_pool_release(p_pool, &p_slabs[i * slab_size]);
+        }
+    }
+    return valid;
+}
+
+bool terminal_init_pooled(Terminal_t *p_terminal,
+                          Terminal_Buffer_Pool_t *p_pool,
+                          char *p_hibernation_blob,
+                          int hibernation_blob_size,
+                          unsigned int idle_timeout_ms,
+                          Terminal_On_Write_Request_t on_write_request,
+                          Terminal_On_Line_Read_t on_line_read,
+                          Terminal_On_Suggestion_Request_t on_suggestion_request)
+{
+    bool initialized = false;
+    char *p_slab = _buffer_pool_acquire(p_pool);
+
+    if (NULL != p_slab)
+    {
+        initialized = terminal_init(p_terminal,
+                                    p_slab,
+                                    p_pool->max_line_len,
+                                    _buffer_pool_get_write_buffer(p_pool, p_slab),
+                                    p_pool->write_buffer_size,
+                                    _buffer_pool_get_history_entries(p_pool, p_slab),
+                                    p_pool->history_max_entries,
+                                    on_write_request,
+                                    on_line_read,
+                                    on_suggestion_request);
+
+        if (initialized)
+        {
+            p_terminal->p_buffer_pool = p_pool;
+            p_terminal->p_hibernation_blob = p_hibernation_blob;
+            p_terminal->hibernation_blob_size = hibernation_blob_size;
+            p_terminal->idle_timeout_ms = idle_timeout_ms;
+        }
+        else
+        {
+            _buffer_pool_release(p_pool, p_slab);
+        }
+    }
+    return initialized;
+}
+
+void terminal_deinit(Terminal_t *p_terminal)
+{
+    if ((NULL != p_terminal->p_buffer_pool) && !p_terminal->hibernated)
+    {
+        /* Line buffer is at the beginning of the slab */
+        _buffer_pool_release(p_terminal->p_buffer_pool, p_terminal->p_line_buffer);
+    }
+    p_terminal->p_buffer_pool = NULL;
+    p_terminal->hibernated = false;
+}
+
+void terminal_tick(Terminal_t *p_terminal, unsigned int elapsed_ms)
+{
+    if ((NULL != p_terminal->p_buffer_pool) && !p_terminal->hibernated && (p_terminal->idle_timeout_ms > 0))
+    {
+        p_terminal->idle_time_ms += elapsed_ms;
+
+        if (p_terminal->idle_time_ms >= p_terminal->idle_timeout_ms)
+        {
+            /* Fails only if the line doesn't fit into the blob - try again after another timeout */
+            p_terminal->idle_time_ms = 0;
+            terminal_hibernate(p_terminal);
+        }
+    }
+}
+
+bool terminal_hibernate(Terminal_t *p_terminal)
+{
+    /* Buffers are still used after on_line_read and on_suggestion_request return, so not from inside them */
+    if (!p_terminal->hibernated &&
+        !p_terminal->in_callback &&
+        (NULL != p_terminal->p_buffer_pool) &&
+        _hibernation_save(p_terminal))
+    {
+        /* Half-received VT100 sequence is stale after the idle time, e.g. a lone ESC - drop it */
+        p_terminal->received_vt100_sequence_len = 0;
+
+        _buffer_pool_release(p_terminal->p_buffer_pool, p_terminal->p_line_buffer);
+
+        p_terminal->p_line_buffer = NULL;
+        p_terminal->p_write_buffer = NULL;
+#if TERMINAL_CONFIG_HISTORY
+        p_terminal->history.p_entries = NULL;
+#endif
+        p_terminal->hibernated = true;
+    }
+    return p_terminal->hibernated;
+}
+
+bool terminal_is_hibernated(Terminal_t *p_terminal)
+{
+    return p_terminal->hibernated;
 }
+#endif
@@ -8,8 +8,14 @@
 #ifndef TERMINAL_H_
 #define TERMINAL_H_
 
+#include "terminal_config.h"
+
 #include <stdbool.h>
 
+#if TERMINAL_CONFIG_ASYNC
+#include <stdatomic.h>
+#endif
+
 #define TERMINAL_VT100_SEQUENCE_MAX_LEN	32
 
 #define TERMINAL_VT100_CURSOR_UP            "\e[A"
@@ -26,6 +32,10 @@
 #define TERMINAL_ASCII_DELETE               127
 #define TERMINAL_ASCII_END_OF_TEXT          3
 
+#define TERMINAL_ASYNC_MESSAGE_MAX_LEN          80
+#define TERMINAL_ASYNC_MAX_LINES_PER_PROCESS    8
+#define TERMINAL_ASYNC_LINES_PER_SECOND         10
+
 typedef struct _Terminal_t Terminal_t;
 typedef int (*Terminal_On_Write_Request_t)(Terminal_t *p_instance, char *p_data, int data_len);
 typedef void (*Terminal_On_Line_Read_t)(Terminal_t *p_instance, char *p_line, int line_len);
@@ -41,6 +51,40 @@ typedef struct _Terminal_History_t
     int displayed_entry_no;
 } Terminal_History_t;
 
+#if TERMINAL_CONFIG_ASYNC
+typedef struct _Terminal_Async_Entry_t
+{
+    atomic_uint sequence;
+    int message_len;
+    char message[TERMINAL_ASYNC_MESSAGE_MAX_LEN + 1];
+} Terminal_Async_Entry_t;
+
+typedef struct _Terminal_Async_Queue_t
+{
+    Terminal_Async_Entry_t *p_entries;
+    unsigned int mask;
+    atomic_uint enqueue_pos;
+    unsigned int dequeue_pos;
+    atomic_uint number_of_dropped;
+    unsigned int line_budget;
+} Terminal_Async_Queue_t;
+#endif
+
+#if TERMINAL_CONFIG_HIBERNATION
+/* Size of one slab - holds line buffer, history entries and write buffer of one session */
+#define TERMINAL_BUFFER_POOL_SLAB_SIZE(max_line_len, write_buffer_size, history_max_entries) \
+    (((history_max_entries) + 1) * ((max_line_len) + 1) + (write_buffer_size))
+
+typedef struct _Terminal_Buffer_Pool_t
+{
+    char *p_free_slabs;
+    int number_of_free_slabs;
+    int max_line_len;
+    int write_buffer_size;
+    int history_max_entries;
+} Terminal_Buffer_Pool_t;
+#endif
+
 typedef struct _Terminal_t
 {
     char *p_line_buffer;
@@ -49,17 +93,40 @@ typedef struct _Terminal_t
     int cursor_pos;
     char *p_write_buffer;
     int write_buffer_size;
+    int write_buffer_len;
+#if TERMINAL_CONFIG_VT100
     char received_vt100_sequence[TERMINAL_VT100_SEQUENCE_MAX_LEN + 1];
+#endif
     int received_vt100_sequence_len;
     Terminal_On_Write_Request_t on_write_request;
     Terminal_On_Line_Read_t on_line_read;
+#if TERMINAL_CONFIG_SUGGESTIONS
     Terminal_On_Suggestion_Request_t on_suggestion_request;
+#endif
+#if TERMINAL_CONFIG_HISTORY
     Terminal_History_t history;
+#endif
+#if TERMINAL_CONFIG_ASYNC
+    Terminal_Async_Queue_t async_queue;
+#endif
+#if TERMINAL_CONFIG_HIBERNATION
+    Terminal_Buffer_Pool_t *p_buffer_pool;
+    char *p_hibernation_blob;
+    int hibernation_blob_size;
+    unsigned int idle_timeout_ms;
+    unsigned int idle_time_ms;
+    bool hibernated;
+    bool in_callback;
+#endif
     char *p_prompt;
     bool echo_disabled;
 } Terminal_t;
 
-void terminal_init(Terminal_t *p_terminal,
+/*
+ * Output of every operation is collected in p_write_buffer and passed to on_write_request at once.
+ * Returns false if max_line_len or history_max_entries differ from sizes fixed in terminal_config.h.
+ */
+bool terminal_init(Terminal_t *p_terminal,
                    char *p_line_buffer,
                    int max_line_len,
                    char *p_write_buffer,
@@ -70,18 +137,89 @@ void terminal_init(Terminal_t *p_terminal,
                    Terminal_On_Line_Read_t on_line_read,
                    Terminal_On_Suggestion_Request_t on_suggestion_request);
 
-void terminal_feed(Terminal_t *p_terminal, char byte);
+/*
+ * Returns false if the byte was not consumed - the terminal is hibernated and the buffer
+ * pool has no free slab to restore it into. Keep the byte and feed it again later.
+ */
+bool terminal_feed(Terminal_t *p_terminal, char byte);
+
+int terminal_write(Terminal_t *p_terminal, const char *p_data, int data_len);
 
+#if TERMINAL_CONFIG_PRINTF
 int terminal_printf(Terminal_t *p_terminal, const char *p_format, ...);
+#endif
 
 void terminal_set_prompt(Terminal_t *p_terminal, char *p_prompt);
 
 void terminal_set_echo_disabled(Terminal_t *p_terminal, bool disabled);
 
+#if TERMINAL_CONFIG_HISTORY
 int terminal_get_number_of_history_entries(Terminal_t *p_terminal);
 
+/*
+ * Returned entry points into the terminal's buffers - it's valid until the next call which
+ * modifies the history or, for a pooled terminal, until the terminal hibernates, as its
+ * buffers may then be given to another terminal. Copy it if it has to be kept longer.
+ */
 char *terminal_get_history_entry(Terminal_t *p_terminal, int entry_no);
 
 void terminal_clear_history(Terminal_t *p_terminal);
+#endif
+
+#if TERMINAL_CONFIG_ASYNC
+/*
+ * Async messages - entries are provided by the caller, number_of_entries must be a power of two,
+ * otherwise terminal_set_async_queue() returns false.
+ * terminal_post_async() may be called from any thread, terminal_process_async() only from
+ * the thread which calls terminal_feed(). Printed lines are limited by a budget refilled with
+ * TERMINAL_ASYNC_LINES_PER_SECOND, up to TERMINAL_ASYNC_MAX_LINES_PER_PROCESS at once.
+ */
+bool terminal_set_async_queue(Terminal_t *p_terminal, Terminal_Async_Entry_t *p_entries, int number_of_entries);
+
+bool terminal_post_async(Terminal_t *p_terminal, const char *p_message);
+
+int terminal_process_async(Terminal_t *p_terminal, unsigned int elapsed_ms);
+#endif
+
+#if TERMINAL_CONFIG_HIBERNATION
+/*
+ * Hibernation - after idle_timeout_ms without input, line, cursor and history of a pooled
+ * terminal are compacted into p_hibernation_blob and its buffers go back to the pool.
+ * Next input restores them - if the pool is exhausted at that time, terminal_feed()
+ * returns false and the byte must be fed again later.
+ * History entries are stored newest first - the oldest ones which don't fit into the blob
+ * are dropped. The terminal doesn't hibernate only if the line itself doesn't fit.
+ * A hibernated terminal keeps Terminal_t, its blob and its async queue entries resident.
+ * terminal_hibernate() and terminal_tick() called from on_line_read or on_suggestion_request
+ * don't hibernate. Neither they nor terminal_deinit() may be called from on_write_request,
+ * and terminal_deinit() not from any callback of the terminal.
+ * All terminals sharing a pool must be used from one thread.
+ * terminal_buffer_pool_init() returns false if slabs are shorter than sizeof(char *)
+ * or sizes differ from those fixed in terminal_config.h.
+ */
+bool terminal_buffer_pool_init(Terminal_Buffer_Pool_t *p_pool,
+                               char *p_slabs,
+                               int number_of_slabs,
+                               int max_line_len,
+                               int write_buffer_size,
+                               int history_max_entries);
+
+bool terminal_init_pooled(Terminal_t *p_terminal,
+                          Terminal_Buffer_Pool_t *p_pool,
+                          char *p_hibernation_blob,
+                          int hibernation_blob_size,
+                          unsigned int idle_timeout_ms,
+                          Terminal_On_Write_Request_t on_write_request,
+                          Terminal_On_Line_Read_t on_line_read,
+                          Terminal_On_Suggestion_Request_t on_suggestion_request);
+
+void terminal_deinit(Terminal_t *p_terminal);
+
+void terminal_tick(Terminal_t *p_terminal, unsigned int elapsed_ms);
+
+bool terminal_hibernate(Terminal_t *p_terminal);
+
+bool terminal_is_hibernated(Terminal_t *p_terminal);
+#endif
 
 #endif /* TERMINAL_H_ */
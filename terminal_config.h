@@ -0,0 +1,101 @@
+/*
+ * terminal_config.h
+ *
+ * Compile-time configuration of the terminal. Select a profile with
+ * -DTERMINAL_PROFILE=TERMINAL_PROFILE_xxx, then override single options
+ * with -DTERMINAL_CONFIG_xxx=... or with own header passed by
+ * -DTERMINAL_CONFIG_FILE=\"my_terminal_config.h\".
+ */
+
+#ifndef TERMINAL_CONFIG_H_
+#define TERMINAL_CONFIG_H_
+
+#ifdef TERMINAL_CONFIG_FILE
+#include TERMINAL_CONFIG_FILE
+#endif
+
+/* Line editing only - no history, suggestions, VT100 keys, printf, async messages and hibernation */
+#define TERMINAL_PROFILE_MINIMAL    1
+/* Interactive console without stdio - history, suggestions and VT100 keys */
+#define TERMINAL_PROFILE_STANDARD   2
+/* All features */
+#define TERMINAL_PROFILE_FULL       3
+
+#ifndef TERMINAL_PROFILE
+#define TERMINAL_PROFILE            TERMINAL_PROFILE_FULL
+#endif
+
+#if TERMINAL_PROFILE == TERMINAL_PROFILE_MINIMAL
+#define _TERMINAL_PROFILE_HISTORY       0
+#define _TERMINAL_PROFILE_SUGGESTIONS   0
+#define _TERMINAL_PROFILE_VT100         0
+#define _TERMINAL_PROFILE_PRINTF        0
+#define _TERMINAL_PROFILE_ASYNC         0
+#define _TERMINAL_PROFILE_HIBERNATION   0
+#elif TERMINAL_PROFILE == TERMINAL_PROFILE_STANDARD
+#define _TERMINAL_PROFILE_HISTORY       1
+#define _TERMINAL_PROFILE_SUGGESTIONS   1
+#define _TERMINAL_PROFILE_VT100         1
+#define _TERMINAL_PROFILE_PRINTF        0
+#define _TERMINAL_PROFILE_ASYNC         0
+#define _TERMINAL_PROFILE_HIBERNATION   0
+#elif TERMINAL_PROFILE == TERMINAL_PROFILE_FULL
+#define _TERMINAL_PROFILE_HISTORY       1
+#define _TERMINAL_PROFILE_SUGGESTIONS   1
+#define _TERMINAL_PROFILE_VT100         1
+#define _TERMINAL_PROFILE_PRINTF        1
+#define _TERMINAL_PROFILE_ASYNC         1
+#define _TERMINAL_PROFILE_HIBERNATION   1
+#else
+#error "Unknown TERMINAL_PROFILE"
+#endif
+
+/* History of entered lines browsed with ARROW UP/DOWN (needs TERMINAL_CONFIG_VT100 to browse) */
+#ifndef TERMINAL_CONFIG_HISTORY
+#define TERMINAL_CONFIG_HISTORY         _TERMINAL_PROFILE_HISTORY
+#endif
+
+/* Suggestions requested with TAB */
+#ifndef TERMINAL_CONFIG_SUGGESTIONS
+#define TERMINAL_CONFIG_SUGGESTIONS     _TERMINAL_PROFILE_SUGGESTIONS
+#endif
+
+/* Arrows, HOME, END and DELETE keys - when disabled, VT100 sequences are still skipped */
+#ifndef TERMINAL_CONFIG_VT100
+#define TERMINAL_CONFIG_VT100           _TERMINAL_PROFILE_VT100
+#endif
+
+/* terminal_printf() - pulls vsnprintf() and most of stdio */
+#ifndef TERMINAL_CONFIG_PRINTF
+#define TERMINAL_CONFIG_PRINTF          _TERMINAL_PROFILE_PRINTF
+#endif
+
+/* terminal_post_async() and terminal_process_async() - needs C11 atomics */
+#ifndef TERMINAL_CONFIG_ASYNC
+#define TERMINAL_CONFIG_ASYNC           _TERMINAL_PROFILE_ASYNC
+#endif
+
+/* Buffer pool and hibernation of idle sessions */
+#ifndef TERMINAL_CONFIG_HIBERNATION
+#define TERMINAL_CONFIG_HIBERNATION     _TERMINAL_PROFILE_HIBERNATION
+#endif
+
+/* Store history entries of hibernated sessions as a suffix of the previous entry */
+#ifndef TERMINAL_CONFIG_HIBERNATION_COMPRESSION
+#define TERMINAL_CONFIG_HIBERNATION_COMPRESSION     1
+#endif
+
+/*
+ * Fixed sizes - when non-zero, the compile-time constant is used instead of the value
+ * stored by terminal_init(), so index arithmetic is folded. terminal_init() fails
+ * when called with a different value.
+ */
+#ifndef TERMINAL_CONFIG_MAX_LINE_LEN
+#define TERMINAL_CONFIG_MAX_LINE_LEN            0
+#endif
+
+#ifndef TERMINAL_CONFIG_HISTORY_MAX_ENTRIES
+#define TERMINAL_CONFIG_HISTORY_MAX_ENTRIES     0
+#endif
+
+#endif /* TERMINAL_CONFIG_H_ */
@@ -0,0 +1,38 @@
+#!/bin/sh
+#
+# footprint.sh
+#
+# Reports code size, RAM per instance and cycles per keystroke of every
+# terminal profile. Code size is measured with $CC (set CC=arm-none-eabi-gcc
+# and CFLAGS="-mcpu=cortex-m0 -mthumb" for target numbers), the benchmark
+# always runs on host with $HOST_CC.
+#
+# Usage: tools/footprint.sh [extra -D options, e.g. -DTERMINAL_CONFIG_MAX_LINE_LEN=64]
+
+set -e
+
+ROOT_DIR=$(cd "$(dirname "$0")/.." && pwd)
+BUILD_DIR=$(mktemp -d)
+trap 'rm -rf "$BUILD_DIR"' EXIT
+
+CC=${CC:-cc}
+HOST_CC=${HOST_CC:-cc}
+CFLAGS=${CFLAGS:-}
+SIZE=${SIZE:-size}
+
+printf "%-10s %-8s %-8s %-8s | %-10s %-10s %-10s %-10s %-12s %s\n" \
+       "profile" "text" "data" "bss" "instance" "buffers" "ram_total" "ram_idle" "writes/key" "feed"
+
+for PROFILE in MINIMAL STANDARD FULL
+do
+    DEFINES="-DTERMINAL_PROFILE=TERMINAL_PROFILE_$PROFILE $*"
+
+    $CC -std=c11 -Os $CFLAGS $DEFINES -I"$ROOT_DIR" -c "$ROOT_DIR/terminal.c" -o "$BUILD_DIR/terminal_$PROFILE.o"
+    CODE_SIZE=$($SIZE "$BUILD_DIR/terminal_$PROFILE.o" | awk 'NR == 2 { printf "%-8s %-8s %-8s", $1, $2, $3 }')
+
+    $HOST_CC -std=c11 -O2 -D_POSIX_C_SOURCE=199309L $DEFINES -I"$ROOT_DIR" \
+             "$ROOT_DIR/terminal.c" "$ROOT_DIR/tools/footprint_bench.c" -o "$BUILD_DIR/bench_$PROFILE"
+    BENCH=$("$BUILD_DIR/bench_$PROFILE")
+
+    printf "%-10s %s | %s\n" "$PROFILE" "$CODE_SIZE" "$BENCH"
+done
@@ -0,0 +1,148 @@
+/*
+ * footprint_bench.c
+ *
+ * Host-side benchmark run by footprint.sh for every profile - prints RAM used by one
+ * terminal instance while active and while hibernated, write requests and cycles spent
+ * in terminal_feed() per keystroke.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_UNIT          "cycles"
+#define BENCH_NOW()         ((unsigned long long) __rdtsc())
+#else
+#define BENCH_UNIT          "ns"
+#define BENCH_NOW()         _now_ns()
+#endif
+
+#include "terminal.h"
+
+/* Sizes fixed at compile time are the only ones terminal_init() accepts */
+#if TERMINAL_CONFIG_MAX_LINE_LEN > 0
+#define MAX_LINE_LENGTH     TERMINAL_CONFIG_MAX_LINE_LEN
+#else
+#define MAX_LINE_LENGTH     64
+#endif
+
+#if TERMINAL_CONFIG_HISTORY_MAX_ENTRIES > 0
+#define MAX_HISTORY_LENGTH  TERMINAL_CONFIG_HISTORY_MAX_ENTRIES
+#else
+#define MAX_HISTORY_LENGTH  8
+#endif
+
+#define WRITE_BUFFER_SIZE   128
+#define ASYNC_QUEUE_LENGTH  4
+#define HIBERNATION_BLOB_SIZE 128
+#define NUMBER_OF_ROUNDS    20000
+
+/* Used by every profile - output of an operation is collected there and written at once */
+char write_buffer[WRITE_BUFFER_SIZE];
+#define WRITE_BUFFER_RAM    sizeof(write_buffer)
+
+char terminal_line_buffer[MAX_LINE_LENGTH + 1];
+
+#if TERMINAL_CONFIG_HISTORY
+char terminal_history_buffer[MAX_HISTORY_LENGTH * (MAX_LINE_LENGTH + 1)];
+#define HISTORY_BUFFER_RAM  sizeof(terminal_history_buffer)
+#else
+#define terminal_history_buffer NULL
+#define HISTORY_BUFFER_RAM  0
+#endif
+
+/* Async ring and blob stay resident also while the terminal is hibernated */
+#if TERMINAL_CONFIG_ASYNC
+Terminal_Async_Entry_t terminal_async_queue[ASYNC_QUEUE_LENGTH];
+#define ASYNC_QUEUE_RAM     sizeof(terminal_async_queue)
+#else
+#define ASYNC_QUEUE_RAM     0
+#endif
+
+#if TERMINAL_CONFIG_HIBERNATION
+#define HIBERNATION_BLOB_RAM    HIBERNATION_BLOB_SIZE
+#define IDLE_RAM            (sizeof(Terminal_t) + ASYNC_QUEUE_RAM + HIBERNATION_BLOB_RAM)
+#else
+#define HIBERNATION_BLOB_RAM    0
+#define IDLE_RAM            TOTAL_RAM
+#endif
+
+#define BUFFERS_RAM         (sizeof(terminal_line_buffer) + WRITE_BUFFER_RAM + HISTORY_BUFFER_RAM + ASYNC_QUEUE_RAM + HIBERNATION_BLOB_RAM)
+#define TOTAL_RAM           (sizeof(Terminal_t) + BUFFERS_RAM)
+
+/* Typing, editing in the middle of the line, history browsing and ENTER */
+static const char keystrokes[] = "set led 1 on" "\e[D\e[D\e[D" "\x7f" "2" "\e[4~" "\r" "\e[A" "\e[B" "\e[1~" "get" "\e[3~" "\x03";
+
+volatile int bytes_written;
+volatile int number_of_writes;
+
+#if !defined(__x86_64__) && !defined(__i386__)
+static unsigned long long _now_ns(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (unsigned long long) now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+#endif
+
+int on_terminal_write_request(Terminal_t *p_terminal, char *p_data, int data_len)
+{
+    bytes_written += data_len;
+    number_of_writes++;
+    return data_len;
+}
+
+void on_terminal_line_read(Terminal_t *p_terminal, char *p_line, int line_len)
+{
+}
+
+int main()
+{
+    Terminal_t console;
+    unsigned long long start;
+    unsigned long long elapsed;
+    int number_of_keystrokes = (sizeof(keystrokes) - 1) * NUMBER_OF_ROUNDS;
+
+    if (!terminal_init(&console,
+                       terminal_line_buffer,
+                       MAX_LINE_LENGTH,
+                       write_buffer,
+                       WRITE_BUFFER_RAM,
+                       terminal_history_buffer,
+                       MAX_HISTORY_LENGTH,
+                       on_terminal_write_request,
+                       on_terminal_line_read,
+                       NULL))
+    {
+        fprintf(stderr, "Failed to initialize terminal\n");
+        return 1;
+    }
+
+#if TERMINAL_CONFIG_ASYNC
+    terminal_set_async_queue(&console, terminal_async_queue, ASYNC_QUEUE_LENGTH);
+#endif
+
+    start = BENCH_NOW();
+
+    for (int round = 0; round < NUMBER_OF_ROUNDS; ++round)
+    {
+        for (int i = 0; i < (int) sizeof(keystrokes) - 1; ++i)
+        {
+            terminal_feed(&console, keystrokes[i]);
+        }
+    }
+
+    elapsed = BENCH_NOW() - start;
+
+    printf("%-10u %-10u %-10u %-10u %-12.2f %.1f %s/key\n",
+           (unsigned int) sizeof(Terminal_t),
+           (unsigned int) BUFFERS_RAM,
+           (unsigned int) TOTAL_RAM,
+           (unsigned int) IDLE_RAM,
+           (double) number_of_writes / number_of_keystrokes,
+           (double) elapsed / number_of_keystrokes,
+           BENCH_UNIT);
+    return 0;
+}
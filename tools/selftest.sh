@@ -0,0 +1,37 @@
+#!/bin/sh
+#
+# selftest.sh
+#
+# Builds and runs the host-side self test for every profile, with hibernation
+# compression off and with sizes fixed at compile time.
+# Set SANITIZE=thread (or address,undefined) to run it with sanitizers.
+#
+# Usage: tools/selftest.sh [extra -D options]
+
+set -e
+
+ROOT_DIR=$(cd "$(dirname "$0")/.." && pwd)
+BUILD_DIR=$(mktemp -d)
+trap 'rm -rf "$BUILD_DIR"' EXIT
+
+CC=${CC:-cc}
+SANITIZE_FLAGS=""
+
+if [ -n "$SANITIZE" ]
+then
+    SANITIZE_FLAGS="-g -fsanitize=$SANITIZE"
+fi
+
+for CONFIG in \
+    "-DTERMINAL_PROFILE=TERMINAL_PROFILE_MINIMAL" \
+    "-DTERMINAL_PROFILE=TERMINAL_PROFILE_STANDARD" \
+    "-DTERMINAL_PROFILE=TERMINAL_PROFILE_FULL" \
+    "-DTERMINAL_PROFILE=TERMINAL_PROFILE_FULL -DTERMINAL_CONFIG_HIBERNATION_COMPRESSION=0" \
+    "-DTERMINAL_PROFILE=TERMINAL_PROFILE_FULL -DTERMINAL_CONFIG_MAX_LINE_LEN=48 -DTERMINAL_CONFIG_HISTORY_MAX_ENTRIES=10"
+do
+    echo "$CONFIG"
+
+    $CC -std=c11 -O2 -D_POSIX_C_SOURCE=200112L $SANITIZE_FLAGS $CONFIG "$@" \
+        -I"$ROOT_DIR" "$ROOT_DIR/terminal.c" "$ROOT_DIR/tools/terminal_selftest.c" -o "$BUILD_DIR/terminal_selftest" -pthread
+    "$BUILD_DIR/terminal_selftest"
+done
@@ -0,0 +1,615 @@
+/*
+ * terminal_selftest.c
+ *
+ * Host-side checks run by selftest.sh for every profile - line editing, several producer
+ * threads against terminal_process_async(), every message must be printed exactly once
+ * and every rejected post reported as dropped, and hibernation round trips.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+
+#include "terminal.h"
+
+/* Sizes fixed at compile time are the only ones terminal_init() accepts */
+#if TERMINAL_CONFIG_MAX_LINE_LEN > 0
+#define MAX_LINE_LENGTH         TERMINAL_CONFIG_MAX_LINE_LEN
+#else
+#define MAX_LINE_LENGTH         64
+#endif
+
+#if TERMINAL_CONFIG_HISTORY_MAX_ENTRIES > 0
+#define MAX_HISTORY_LENGTH      TERMINAL_CONFIG_HISTORY_MAX_ENTRIES
+#else
+#define MAX_HISTORY_LENGTH      8
+#endif
+
+#define WRITE_BUFFER_SIZE       256
+
+#define ASYNC_QUEUE_LENGTH      64
+#define NUMBER_OF_PRODUCERS     4
+#define MESSAGES_PER_PRODUCER   20000
+
+#define CHECK(condition)                                                            \
+    do                                                                              \
+    {                                                                               \
+        if (!(condition))                                                           \
+        {                                                                           \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition);    \
+            number_of_failures++;                                                   \
+        }                                                                           \
+    } while (0)
+
+int number_of_failures;
+int number_of_writes;
+
+char write_buffer[WRITE_BUFFER_SIZE];
+char terminal_line_buffer[MAX_LINE_LENGTH + 1];
+char terminal_history_buffer[MAX_HISTORY_LENGTH * (MAX_LINE_LENGTH + 1)];
+
+/* Output is split into lines, only text after the last carriage return is the printed line */
+char output_line[1024];
+int output_line_len;
+
+void (*on_output_line)(char *p_line);
+
+int on_terminal_write_request(Terminal_t *p_terminal, char *p_data, int data_len)
+{
+    number_of_writes++;
+
+    for (int i = 0; i < data_len; ++i)
+    {
+        if ('\n' == p_data[i])
+        {
+            char *p_line = output_line;
+            char *p_carriage_return;
+
+            output_line[output_line_len] = '\0';
+
+            if ((output_line_len > 0) && ('\r' == output_line[output_line_len - 1]))
+            {
+                output_line[output_line_len - 1] = '\0';
+            }
+
+            p_carriage_return = strrchr(output_line, '\r');
+
+            if (NULL != p_carriage_return)
+            {
+                p_line = p_carriage_return + 1;
+            }
+            if (NULL != on_output_line)
+            {
+                on_output_line(p_line);
+            }
+            output_line_len = 0;
+        }
+        else if (output_line_len < (int) sizeof(output_line) - 1)
+        {
+            output_line[output_line_len++] = p_data[i];
+        }
+    }
+    return data_len;
+}
+
+bool hibernate_on_line_read;
+char line_read[MAX_LINE_LENGTH + 1];
+
+void on_terminal_line_read(Terminal_t *p_terminal, char *p_line, int line_len)
+{
+    CHECK((int) strlen(p_line) == line_len);
+    strcpy(line_read, p_line);
+
+#if TERMINAL_CONFIG_HIBERNATION
+    if (hibernate_on_line_read)
+    {
+        /* Line buffer is still used when the callback returns */
+        CHECK(!terminal_hibernate(p_terminal));
+    }
+#endif
+}
+
+static void _init_terminal(Terminal_t *p_terminal)
+{
+    output_line_len = 0;
+
+    CHECK(terminal_init(p_terminal,
+                        terminal_line_buffer,
+                        MAX_LINE_LENGTH,
+                        write_buffer,
+                        sizeof(write_buffer),
+                        terminal_history_buffer,
+                        MAX_HISTORY_LENGTH,
+                        on_terminal_write_request,
+                        on_terminal_line_read,
+                        NULL));
+}
+
+/*
+ * Output
+ */
+static void _feed(Terminal_t *p_terminal, const char *p_bytes)
+{
+    while ('\0' != *p_bytes)
+    {
+        terminal_feed(p_terminal, *p_bytes++);
+    }
+}
+
+static void _test_output_batching(void)
+{
+    Terminal_t terminal;
+
+    _init_terminal(&terminal);
+    on_output_line = NULL;
+
+    number_of_writes = 0;
+    terminal_set_prompt(&terminal, "$ ");
+    CHECK(1 == number_of_writes);
+
+    _feed(&terminal, "set led 1 on\r");
+
+#if TERMINAL_CONFIG_VT100 && TERMINAL_CONFIG_HISTORY
+    /* Erasing the line, prompt and history entry go out in one write */
+    number_of_writes = 0;
+    _feed(&terminal, "\e[A");
+    CHECK(1 == number_of_writes);
+#endif
+
+#if TERMINAL_CONFIG_MAX_LINE_LEN > 0
+    CHECK(!terminal_init(&terminal,
+                         terminal_line_buffer,
+                         TERMINAL_CONFIG_MAX_LINE_LEN - 1,
+                         write_buffer,
+                         sizeof(write_buffer),
+                         terminal_history_buffer,
+                         MAX_HISTORY_LENGTH,
+                         on_terminal_write_request,
+                         on_terminal_line_read,
+                         NULL));
+#endif
+}
+
+/*
+ * Line editing
+ */
+static void _test_line_editing(void)
+{
+    Terminal_t terminal;
+
+    _init_terminal(&terminal);
+    on_output_line = NULL;
+
+    /* BACKSPACE at the end of the line */
+    _feed(&terminal, "set led 1 onn\x7f\r");
+    CHECK(0 == strcmp("set led 1 on", line_read));
+
+    /* CTRL+C drops the line */
+    _feed(&terminal, "reboot\x03" "status\r");
+    CHECK(0 == strcmp("status", line_read));
+
+    /* VT100 sequences are skipped also when the keys are disabled */
+    _feed(&terminal, "get\e[15~ temp\r");
+    CHECK(0 == strcmp("get temp", line_read));
+
+    /* Characters over the line length are ignored */
+    for (int i = 0; i < MAX_LINE_LENGTH + 10; ++i)
+    {
+        terminal_feed(&terminal, 'x');
+    }
+    terminal_feed(&terminal, '\r');
+    CHECK(MAX_LINE_LENGTH == (int) strlen(line_read));
+
+#if TERMINAL_CONFIG_VT100
+    /* LEFT, BACKSPACE and insert in the middle, then HOME, DELETE and END */
+    _feed(&terminal, "set led 1 on\e[D\e[D\e[D\x7f" "2\e[1~\e[3~S\e[4~!\r");
+    CHECK(0 == strcmp("Set led 2 on!", line_read));
+#endif
+
+#if TERMINAL_CONFIG_VT100 && TERMINAL_CONFIG_HISTORY
+    _feed(&terminal, "\e[A\e[A\e[A\e[A\e[B\r");
+    CHECK(0 == strcmp("get temp", line_read));
+    CHECK(0 == strcmp("get temp", terminal_get_history_entry(&terminal, 0)));
+#endif
+}
+
+#if TERMINAL_CONFIG_ASYNC
+/*
+ * Async queue
+ */
+Terminal_t async_terminal;
+Terminal_Async_Entry_t async_queue[ASYNC_QUEUE_LENGTH];
+unsigned char async_received[NUMBER_OF_PRODUCERS][MESSAGES_PER_PRODUCER];
+int async_last_received[NUMBER_OF_PRODUCERS];
+int async_number_of_rejected[NUMBER_OF_PRODUCERS];
+int async_number_of_received;
+int async_number_of_reported_dropped;
+int async_number_of_out_of_order;
+atomic_int async_number_of_finished_producers;
+
+static void _on_async_output_line(char *p_line)
+{
+    int producer_no;
+    int message_no;
+    unsigned int number_of_dropped;
+
+    if (2 == sscanf(p_line, "producer %d message %d", &producer_no, &message_no))
+    {
+        CHECK(producer_no >= 0 && producer_no < NUMBER_OF_PRODUCERS);
+        CHECK(message_no >= 0 && message_no < MESSAGES_PER_PRODUCER);
+        CHECK(NULL == strstr(p_line, "(x"));
+
+        if (message_no <= async_last_received[producer_no])
+        {
+            async_number_of_out_of_order++;
+        }
+        async_last_received[producer_no] = message_no;
+        async_received[producer_no][message_no]++;
+        async_number_of_received++;
+    }
+    else if (1 == sscanf(p_line, "<%u messages dropped>", &number_of_dropped))
+    {
+        async_number_of_reported_dropped += number_of_dropped;
+    }
+}
+
+static void *_async_producer(void *p_argument)
+{
+    int producer_no = (int) (long) p_argument;
+    char message[TERMINAL_ASYNC_MESSAGE_MAX_LEN + 1];
+
+    for (int message_no = 0; message_no < MESSAGES_PER_PRODUCER; ++message_no)
+    {
+        snprintf(message, sizeof(message), "producer %d message %d", producer_no, message_no);
+
+        /* Queue full - post is reported as dropped, retry so the message is printed anyway */
+        while (!terminal_post_async(&async_terminal, message))
+        {
+            async_number_of_rejected[producer_no]++;
+            sched_yield();
+        }
+    }
+    atomic_fetch_add(&async_number_of_finished_producers, 1);
+    return NULL;
+}
+
+static void _test_async_multiple_producers(void)
+{
+    pthread_t producers[NUMBER_OF_PRODUCERS];
+    int number_of_rejected = 0;
+    int number_of_lost = 0;
+    int number_of_duplicated = 0;
+
+    _init_terminal(&async_terminal);
+    on_output_line = _on_async_output_line;
+
+    CHECK(!terminal_set_async_queue(&async_terminal, async_queue, 0));
+    CHECK(!terminal_set_async_queue(&async_terminal, async_queue, 10));
+    CHECK(terminal_set_async_queue(&async_terminal, async_queue, ASYNC_QUEUE_LENGTH));
+
+    for (int i = 0; i < NUMBER_OF_PRODUCERS; ++i)
+    {
+        async_last_received[i] = -1;
+        pthread_create(&producers[i], NULL, _async_producer, (void *) (long) i);
+    }
+
+    /* Plenty of budget on every call, so the consumer keeps up with producers as much as possible */
+    while (NUMBER_OF_PRODUCERS != atomic_load(&async_number_of_finished_producers))
+    {
+        terminal_process_async(&async_terminal, 1000);
+    }
+
+    for (int i = 0; i < NUMBER_OF_PRODUCERS; ++i)
+    {
+        pthread_join(producers[i], NULL);
+    }
+
+    while (terminal_process_async(&async_terminal, 1000) > 0)
+    {
+    }
+    /* Last call prints drops counted after the queue was emptied */
+    terminal_process_async(&async_terminal, 1000);
+
+    for (int producer_no = 0; producer_no < NUMBER_OF_PRODUCERS; ++producer_no)
+    {
+        number_of_rejected += async_number_of_rejected[producer_no];
+
+        for (int message_no = 0; message_no < MESSAGES_PER_PRODUCER; ++message_no)
+        {
+            if (async_received[producer_no][message_no] > 1)
+            {
+                number_of_duplicated++;
+            }
+        }
+    }
+    number_of_lost = NUMBER_OF_PRODUCERS * MESSAGES_PER_PRODUCER - async_number_of_received;
+
+    printf("async: %d received, %d posts rejected\n", async_number_of_received, number_of_rejected);
+
+    CHECK(0 == number_of_lost);
+    CHECK(0 == number_of_duplicated);
+    CHECK(0 == async_number_of_out_of_order);
+    CHECK(number_of_rejected == async_number_of_reported_dropped);
+}
+
+static void _test_async_rate_limit(void)
+{
+    int number_of_lines = 0;
+
+    _init_terminal(&async_terminal);
+    on_output_line = NULL;
+    CHECK(terminal_set_async_queue(&async_terminal, async_queue, ASYNC_QUEUE_LENGTH));
+
+    for (int i = 0; i < ASYNC_QUEUE_LENGTH; ++i)
+    {
+        char message[32];
+
+        snprintf(message, sizeof(message), "line %d", i);
+        terminal_post_async(&async_terminal, message);
+    }
+
+    /* Full budget at start, then refilled by TERMINAL_ASYNC_LINES_PER_SECOND */
+    number_of_lines += terminal_process_async(&async_terminal, 0);
+    CHECK(TERMINAL_ASYNC_MAX_LINES_PER_PROCESS == number_of_lines);
+
+    number_of_lines += terminal_process_async(&async_terminal, 0);
+    CHECK(TERMINAL_ASYNC_MAX_LINES_PER_PROCESS == number_of_lines);
+
+    number_of_lines += terminal_process_async(&async_terminal, 1000 / TERMINAL_ASYNC_LINES_PER_SECOND);
+    CHECK(TERMINAL_ASYNC_MAX_LINES_PER_PROCESS + 1 == number_of_lines);
+
+    /* Identical messages are coalesced into one line, but not beyond one queue length per call */
+    _init_terminal(&async_terminal);
+    CHECK(terminal_set_async_queue(&async_terminal, async_queue, ASYNC_QUEUE_LENGTH));
+
+    for (int i = 0; i < ASYNC_QUEUE_LENGTH; ++i)
+    {
+        terminal_post_async(&async_terminal, "same");
+    }
+    CHECK(ASYNC_QUEUE_LENGTH == terminal_process_async(&async_terminal, 0));
+}
+#endif
+
+/*
+ * Hibernation
+ */
+#if TERMINAL_CONFIG_HIBERNATION
+#define NUMBER_OF_SLABS         2
+#define HIBERNATION_BLOB_SIZE   256
+
+char hibernation_slabs[NUMBER_OF_SLABS * TERMINAL_BUFFER_POOL_SLAB_SIZE(MAX_LINE_LENGTH, WRITE_BUFFER_SIZE, MAX_HISTORY_LENGTH)];
+char hibernation_blobs[NUMBER_OF_SLABS][HIBERNATION_BLOB_SIZE];
+Terminal_Buffer_Pool_t hibernation_pool;
+
+static void _test_hibernation_round_trip(void)
+{
+    Terminal_t terminal;
+    Terminal_t other_terminals[NUMBER_OF_SLABS];
+    char history[MAX_HISTORY_LENGTH][MAX_LINE_LENGTH + 1];
+    char line[MAX_LINE_LENGTH + 1];
+    int number_of_entries;
+    int displayed_entry_no;
+    int cursor_pos;
+
+    on_output_line = NULL;
+    CHECK(terminal_buffer_pool_init(&hibernation_pool, hibernation_slabs, NUMBER_OF_SLABS, MAX_LINE_LENGTH, WRITE_BUFFER_SIZE, MAX_HISTORY_LENGTH));
+    CHECK(terminal_init_pooled(&terminal,
+                               &hibernation_pool,
+                               hibernation_blobs[0],
+                               HIBERNATION_BLOB_SIZE,
+                               1000,
+                               on_terminal_write_request,
+                               on_terminal_line_read,
+                               NULL));
+
+    /* More lines than history entries, so the ring wraps around; common prefixes get compressed */
+    for (int i = 0; i < MAX_HISTORY_LENGTH + 3; ++i)
+    {
+        char command[MAX_LINE_LENGTH + 1];
+
+        snprintf(command, sizeof(command), "set led %d %s\r", i, (i % 2) ? "on" : "off");
+        _feed(&terminal, command);
+    }
+    _feed(&terminal, "\e[A\e[Aget temp\e[D\e[D");
+
+    number_of_entries = terminal_get_number_of_history_entries(&terminal);
+    CHECK(MAX_HISTORY_LENGTH == number_of_entries);
+
+    for (int i = 0; i < number_of_entries; ++i)
+    {
+        strcpy(history[i], terminal_get_history_entry(&terminal, i));
+    }
+    strcpy(line, terminal.p_line_buffer);
+    cursor_pos = terminal.cursor_pos;
+    displayed_entry_no = terminal.history.displayed_entry_no;
+
+    /* Not idle long enough yet */
+    terminal_tick(&terminal, 999);
+    CHECK(!terminal_is_hibernated(&terminal));
+
+    terminal_tick(&terminal, 1);
+    CHECK(terminal_is_hibernated(&terminal));
+    CHECK(NUMBER_OF_SLABS == hibernation_pool.number_of_free_slabs);
+    CHECK(number_of_entries == terminal_get_number_of_history_entries(&terminal));
+    CHECK(terminal_is_hibernated(&terminal));
+
+    /* Pool exhausted - input is not consumed until a slab is free */
+    for (int i = 0; i < NUMBER_OF_SLABS; ++i)
+    {
+        CHECK(terminal_init_pooled(&other_terminals[i],
+                                   &hibernation_pool,
+                                   hibernation_blobs[1],
+                                   HIBERNATION_BLOB_SIZE,
+                                   1000,
+                                   on_terminal_write_request,
+                                   on_terminal_line_read,
+                                   NULL));
+    }
+    CHECK(!terminal_feed(&terminal, 'x'));
+    CHECK(terminal_is_hibernated(&terminal));
+
+    terminal_deinit(&other_terminals[0]);
+
+    /* Any call which needs buffers restores the session */
+    CHECK(0 == strcmp(history[0], terminal_get_history_entry(&terminal, 0)));
+    CHECK(!terminal_is_hibernated(&terminal));
+    CHECK(0 == hibernation_pool.number_of_free_slabs);
+
+    for (int i = 0; i < number_of_entries; ++i)
+    {
+        CHECK(0 == strcmp(history[i], terminal_get_history_entry(&terminal, i)));
+    }
+    CHECK(0 == strcmp(line, terminal.p_line_buffer));
+    CHECK((int) strlen(line) == terminal.current_line_len);
+    CHECK(cursor_pos == terminal.cursor_pos);
+    CHECK(displayed_entry_no == terminal.history.displayed_entry_no);
+
+    /* Restored history keeps working - new entries wrap around again */
+    _feed(&terminal, "\r");
+    CHECK(0 == strcmp(line, terminal_get_history_entry(&terminal, 0)));
+    CHECK(0 == strcmp(history[0], terminal_get_history_entry(&terminal, 1)));
+    CHECK(MAX_HISTORY_LENGTH == terminal_get_number_of_history_entries(&terminal));
+
+    /* Hibernation requested by a command is refused, the session keeps working */
+    hibernate_on_line_read = true;
+    _feed(&terminal, "logout\r");
+    hibernate_on_line_read = false;
+    CHECK(!terminal_is_hibernated(&terminal));
+    CHECK(0 == strcmp("logout", terminal_get_history_entry(&terminal, 0)));
+
+    /* Lone ESC before going idle doesn't keep the session awake - next byte is a normal key */
+    _feed(&terminal, "\e");
+    terminal_tick(&terminal, 1000);
+    CHECK(terminal_is_hibernated(&terminal));
+    CHECK(terminal_feed(&terminal, 'A'));
+    CHECK(0 == strcmp("A", terminal.p_line_buffer));
+
+    /* Line which doesn't fit into the blob keeps the session awake */
+    _feed(&terminal, "get temp");
+    terminal.hibernation_blob_size = 8;
+    CHECK(!terminal_hibernate(&terminal));
+    CHECK(!terminal_is_hibernated(&terminal));
+
+    terminal_deinit(&terminal);
+    terminal_deinit(&other_terminals[1]);
+    CHECK(NUMBER_OF_SLABS == hibernation_pool.number_of_free_slabs);
+}
+
+static void _test_hibernation_partial_history(void)
+{
+    Terminal_t terminal;
+    char blob[100];
+    char history[MAX_HISTORY_LENGTH][MAX_LINE_LENGTH + 1];
+    int number_of_entries;
+
+    on_output_line = NULL;
+    CHECK(terminal_buffer_pool_init(&hibernation_pool, hibernation_slabs, 1, MAX_LINE_LENGTH, WRITE_BUFFER_SIZE, MAX_HISTORY_LENGTH));
+    CHECK(terminal_init_pooled(&terminal,
+                               &hibernation_pool,
+                               blob,
+                               sizeof(blob),
+                               1000,
+                               on_terminal_write_request,
+                               on_terminal_line_read,
+                               NULL));
+
+    /* Entries differ from the first character, so nothing is compressed and the history doesn't fit */
+    for (int i = 0; i < MAX_HISTORY_LENGTH; ++i)
+    {
+        char command[MAX_LINE_LENGTH + 1];
+
+        snprintf(command, sizeof(command), "%c command long enough to fill\r", 'a' + i);
+        _feed(&terminal, command);
+    }
+    _feed(&terminal, "\e[A\e[A\e[A\e[A\e[A\e[A");
+
+    for (int i = 0; i < MAX_HISTORY_LENGTH; ++i)
+    {
+        strcpy(history[i], terminal_get_history_entry(&terminal, i));
+    }
+
+    /* Oldest entries are dropped instead of keeping the session awake */
+    terminal_tick(&terminal, 1000);
+    CHECK(terminal_is_hibernated(&terminal));
+    CHECK(1 == hibernation_pool.number_of_free_slabs);
+
+    number_of_entries = terminal_get_number_of_history_entries(&terminal);
+    CHECK(number_of_entries > 0 && number_of_entries < MAX_HISTORY_LENGTH);
+
+    CHECK(terminal_feed(&terminal, 'x'));
+    CHECK(!terminal_is_hibernated(&terminal));
+    CHECK(number_of_entries == terminal_get_number_of_history_entries(&terminal));
+    CHECK(terminal.history.displayed_entry_no < number_of_entries);
+
+    for (int i = 0; i < number_of_entries; ++i)
+    {
+        CHECK(0 == strcmp(history[i], terminal_get_history_entry(&terminal, i)));
+    }
+    CHECK(NULL == terminal_get_history_entry(&terminal, number_of_entries));
+
+    /* New entries are added on top of the restored ones */
+    _feed(&terminal, "\r");
+    CHECK(number_of_entries + 1 == terminal_get_number_of_history_entries(&terminal));
+    CHECK(0 == strcmp(history[0], terminal_get_history_entry(&terminal, 1)));
+
+    terminal_deinit(&terminal);
+}
+
+#if TERMINAL_CONFIG_ASYNC
+static void _test_hibernation_async(void)
+{
+    Terminal_t terminal;
+
+    on_output_line = NULL;
+    CHECK(terminal_buffer_pool_init(&hibernation_pool, hibernation_slabs, 1, MAX_LINE_LENGTH, WRITE_BUFFER_SIZE, MAX_HISTORY_LENGTH));
+    CHECK(terminal_init_pooled(&terminal,
+                               &hibernation_pool,
+                               hibernation_blobs[0],
+                               HIBERNATION_BLOB_SIZE,
+                               1000,
+                               on_terminal_write_request,
+                               on_terminal_line_read,
+                               NULL));
+    CHECK(terminal_set_async_queue(&terminal, async_queue, ASYNC_QUEUE_LENGTH));
+
+    _feed(&terminal, "status");
+    terminal_tick(&terminal, 600);
+    CHECK(terminal_hibernate(&terminal));
+
+    /* Messages are printed from the hibernated state - no slab taken, idle time kept */
+    terminal_post_async(&terminal, "log message");
+    CHECK(1 == terminal_process_async(&terminal, 0));
+    CHECK(terminal_is_hibernated(&terminal));
+    CHECK(1 == hibernation_pool.number_of_free_slabs);
+    CHECK(600 == terminal.idle_time_ms);
+
+    CHECK(terminal_feed(&terminal, '\r'));
+    CHECK(0 == strcmp("status", terminal_get_history_entry(&terminal, 0)));
+
+    terminal_deinit(&terminal);
+}
+#endif
+#endif
+
+int main()
+{
+    _test_output_batching();
+    _test_line_editing();
+
+#if TERMINAL_CONFIG_ASYNC
+    _test_async_multiple_producers();
+    _test_async_rate_limit();
+#endif
+
+#if TERMINAL_CONFIG_HIBERNATION
+    _test_hibernation_round_trip();
+    _test_hibernation_partial_history();
+#if TERMINAL_CONFIG_ASYNC
+    _test_hibernation_async();
+#endif
+#endif
+
+    printf("%s\n", (0 == number_of_failures) ? "PASS" : "FAIL");
+    return (0 == number_of_failures) ? 0 : 1;
+}